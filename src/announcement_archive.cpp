@@ -0,0 +1,823 @@
+#include "include/announcement_archive.h"
+#include <zlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+// BM25 parameters, the usual defaults
+constexpr double BM25_K1 = 1.2;
+constexpr double BM25_B = 0.75;
+
+constexpr size_t MIN_TERM_LENGTH = 2;
+constexpr size_t MAX_TERM_LENGTH = 40;
+constexpr size_t SNIPPET_LENGTH = 200;
+
+constexpr const char* SPOOL_EXTENSION = ".item";
+
+constexpr uint32_t RECORD_MAGIC = 0x31435241;  // "ARC1"
+constexpr uint32_t SEGMENT_MAGIC = 0x31584449; // "IDX1"
+
+// All on-disk structures are in host byte order
+struct RecordHeader {
+	uint32_t magic;
+	uint32_t compressed_size;
+	uint32_t raw_size;
+	uint32_t reserved;
+	int64_t archived_at;
+};
+
+struct SegmentHeader {
+	uint32_t magic;
+	uint32_t first_document;
+	uint32_t end_document;
+	uint32_t term_count;
+	uint32_t strings_size;
+	uint32_t reserved;
+};
+
+// Sorted by term, followed by the term strings and then every posting list back to back
+struct TermEntry {
+	uint32_t string_offset;
+	uint32_t string_length;
+	uint32_t postings_offset; // In postings, not bytes
+	uint32_t postings_count;
+};
+
+static_assert(sizeof(RecordHeader) == 24 && sizeof(SegmentHeader) == 24 && sizeof(TermEntry) == 16);
+
+static const std::unordered_set<std::string_view> STOP_WORDS = {
+	"an", "and", "are", "as", "at", "be", "by", "for", "from", "has", "have", "in", "is", "it",
+	"its", "of", "on", "or", "that", "the", "this", "to", "was", "will", "with", "you", "your"
+};
+
+static uint64_t fnv1a(std::string_view data, uint64_t hash = 0xcbf29ce484222325ULL) {
+	for (unsigned char c : data) {
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static uint64_t documentKey(std::string_view feed_url, std::string_view title) {
+	return fnv1a(title, fnv1a("\n", fnv1a(feed_url)));
+}
+
+// Title terms count twice so an announcement about X ranks above one that mentions X in passing
+static std::vector<std::string> documentTerms(const std::string& title, const std::string& content) {
+	std::vector<std::string> terms = AnnouncementArchive::tokenize(title);
+	const size_t title_terms = terms.size();
+	terms.reserve(title_terms * 2);
+	for (size_t i = 0; i < title_terms; ++i) {
+		terms.push_back(terms[i]);
+	}
+	for (auto& term : AnnouncementArchive::tokenize(content)) {
+		terms.push_back(std::move(term));
+	}
+	return terms;
+}
+
+static std::string lowercase(std::string_view text) {
+	std::string lowered(text);
+	for (char& c : lowered) {
+		if (c >= 'A' && c <= 'Z') {
+			c = static_cast<char>(c - 'A' + 'a');
+		}
+	}
+	return lowered;
+}
+
+static std::string makeSnippet(const std::string& content, const std::vector<std::string>& terms) {
+	const std::string lowered = lowercase(content);
+	size_t match = std::string::npos;
+	for (const auto& term : terms) {
+		match = std::min(match, lowered.find(term));
+	}
+
+	size_t start = 0;
+	if (match != std::string::npos && match > SNIPPET_LENGTH / 3) {
+		start = content.find(' ', match - SNIPPET_LENGTH / 3);
+		start = start == std::string::npos || start > match ? match : start + 1;
+	}
+	// Don't cut a UTF-8 sequence in half
+	while (start < content.size() && (static_cast<unsigned char>(content[start]) & 0xC0) == 0x80) {
+		++start;
+	}
+	size_t end = std::min(content.size(), start + SNIPPET_LENGTH);
+	while (end < content.size() && (static_cast<unsigned char>(content[end]) & 0xC0) == 0x80) {
+		--end;
+	}
+
+	std::string snippet = content.substr(start, end - start);
+	std::replace(snippet.begin(), snippet.end(), '\n', ' ');
+	return (start > 0 ? "..." : "") + snippet + (end < content.size() ? "..." : "");
+}
+
+class AnnouncementArchive::Segment {
+public:
+	static std::unique_ptr<Segment> open(const std::string& path) {
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return nullptr;
+		}
+		struct stat info {};
+		if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SegmentHeader)) {
+			::close(fd);
+			return nullptr;
+		}
+
+		const size_t size = static_cast<size_t>(info.st_size);
+		void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (data == MAP_FAILED) {
+			return nullptr;
+		}
+
+		std::unique_ptr<Segment> segment(new Segment(path, data, size));
+		if (!segment->valid()) {
+			return nullptr;
+		}
+		return segment;
+	}
+
+	~Segment() {
+		munmap(data_, size_);
+	}
+
+	uint32_t first() const { return header_->first_document; }
+	uint32_t end() const { return header_->end_document; }
+	const std::string& path() const { return path_; }
+	size_t termCount() const { return header_->term_count; }
+
+	std::string_view termAt(size_t index) const {
+		return { strings_ + terms_[index].string_offset, terms_[index].string_length };
+	}
+
+	std::pair<const Posting*, size_t> postingsAt(size_t index) const {
+		return { postings_ + terms_[index].postings_offset, terms_[index].postings_count };
+	}
+
+	std::pair<const Posting*, size_t> find(std::string_view term) const {
+		size_t low = 0;
+		size_t high = termCount();
+		while (low < high) {
+			const size_t middle = low + (high - low) / 2;
+			const int order = termAt(middle).compare(term);
+			if (order == 0) {
+				return postingsAt(middle);
+			}
+			if (order < 0) {
+				low = middle + 1;
+			}
+			else {
+				high = middle;
+			}
+		}
+		return { nullptr, 0 };
+	}
+
+private:
+	std::string path_;
+	void* data_;
+	size_t size_;
+	const SegmentHeader* header_;
+	const TermEntry* terms_ = nullptr;
+	const char* strings_ = nullptr;
+	const Posting* postings_ = nullptr;
+	size_t postings_count_ = 0;
+
+	Segment(const std::string& path, void* data, size_t size)
+		: path_(path), data_(data), size_(size), header_(static_cast<const SegmentHeader*>(data)) {
+	}
+
+	// Bounds checks everything find() will touch, a torn or foreign file is rejected
+	bool valid() {
+		if (header_->magic != SEGMENT_MAGIC || header_->end_document < header_->first_document) {
+			return false;
+		}
+
+		const char* base = static_cast<const char*>(data_);
+		const size_t terms_end = sizeof(SegmentHeader) + size_t(header_->term_count) * sizeof(TermEntry);
+		const size_t postings_start = (terms_end + header_->strings_size + 3) & ~size_t(3);
+		if (postings_start > size_ || (size_ - postings_start) % sizeof(Posting) != 0) {
+			return false;
+		}
+
+		terms_ = reinterpret_cast<const TermEntry*>(base + sizeof(SegmentHeader));
+		strings_ = base + terms_end;
+		postings_ = reinterpret_cast<const Posting*>(base + postings_start);
+		postings_count_ = (size_ - postings_start) / sizeof(Posting);
+
+		for (size_t i = 0; i < header_->term_count; ++i) {
+			const TermEntry& entry = terms_[i];
+			if (size_t(entry.string_offset) + entry.string_length > header_->strings_size ||
+				size_t(entry.postings_offset) + entry.postings_count > postings_count_) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+AnnouncementArchive::AnnouncementArchive(const std::string& directory) : directory_(directory) {
+	load();
+}
+
+AnnouncementArchive::~AnnouncementArchive() {
+	if (log_file_) {
+		std::fclose(log_file_);
+	}
+	if (documents_file_) {
+		std::fclose(documents_file_);
+	}
+	if (log_fd_ >= 0) {
+		::close(log_fd_);
+	}
+}
+
+std::vector<std::string> AnnouncementArchive::tokenize(std::string_view text) {
+	std::vector<std::string> terms;
+	std::string term;
+
+	auto finish = [&]() {
+		if (term.size() >= MIN_TERM_LENGTH && term.size() <= MAX_TERM_LENGTH && !STOP_WORDS.count(term)) {
+			terms.push_back(term);
+		}
+		term.clear();
+	};
+
+	// ASCII letters and digits, plus any non-ASCII byte so accented words stay whole
+	for (char c : text) {
+		const unsigned char byte = static_cast<unsigned char>(c);
+		if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || byte >= 0x80) {
+			term += c;
+		}
+		else if (c >= 'A' && c <= 'Z') {
+			term += static_cast<char>(c - 'A' + 'a');
+		}
+		else {
+			finish();
+		}
+	}
+	finish();
+	return terms;
+}
+
+bool AnnouncementArchive::append(const std::string& feed_url, const std::string& title, const std::string& content) {
+	const uint64_t key = documentKey(feed_url, title);
+
+	std::unique_lock<std::shared_mutex> lock(mutex_);
+	if (!log_file_ || !documents_file_ || keys_.count(key)) {
+		return false;
+	}
+
+	std::string raw;
+	raw.reserve(feed_url.size() + title.size() + content.size() + 2);
+	raw.append(feed_url).push_back('\0');
+	raw.append(title).push_back('\0');
+	raw.append(content);
+
+	uLongf compressed_size = compressBound(raw.size());
+	std::vector<Bytef> compressed(compressed_size);
+	if (compress2(compressed.data(), &compressed_size, reinterpret_cast<const Bytef*>(raw.data()), raw.size(), Z_BEST_COMPRESSION) != Z_OK) {
+		std::cerr << "Failed to compress announcement \"" << title << "\"\n";
+		return false;
+	}
+
+	RecordHeader header{};
+	header.magic = RECORD_MAGIC;
+	header.compressed_size = static_cast<uint32_t>(compressed_size);
+	header.raw_size = static_cast<uint32_t>(raw.size());
+	header.archived_at = std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+
+	const std::vector<std::string> terms = documentTerms(title, content);
+	Document document{ log_size_, key, static_cast<uint32_t>(sizeof(header) + compressed_size), static_cast<uint32_t>(terms.size()) };
+
+	// The record goes first, a document entry never points past the end of the log
+	if (std::fwrite(&header, sizeof(header), 1, log_file_) != 1 ||
+		std::fwrite(compressed.data(), 1, compressed_size, log_file_) != compressed_size ||
+		std::fflush(log_file_) != 0 ||
+		std::fwrite(&document, sizeof(document), 1, documents_file_) != 1 ||
+		std::fflush(documents_file_) != 0) {
+		std::cerr << "Failed to write announcement archive, closing it until restart\n";
+		std::fclose(log_file_);
+		std::fclose(documents_file_);
+		log_file_ = documents_file_ = nullptr;
+		return false;
+	}
+
+	const uint32_t id = static_cast<uint32_t>(documents_.size());
+	documents_.push_back(document);
+	keys_.insert(key);
+	total_terms_ += document.term_count;
+	log_size_ += document.record_size;
+
+	indexDocument(id, terms);
+	if (documents_.size() - memtable_first_ < MEMTABLE_DOCUMENTS) {
+		return true;
+	}
+
+	freezeMemtable();
+	lock.unlock();
+	maintainSegments();
+	return true;
+}
+
+// Spooled items are "<unix ms>-<writer>-<sequence>.item" holding feed URL, title and content,
+// NUL separated like a log record. Written to a temporary name first so imports never see half of one.
+bool AnnouncementArchive::spool(const std::string& inbox, const std::string& writer,
+	const std::string& feed_url, const std::string& title, const std::string& content) {
+	static std::atomic<uint64_t> sequence = 0;
+	const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+
+	char stamp[32];
+	std::snprintf(stamp, sizeof(stamp), "%016lld", static_cast<long long>(now));
+	const std::string final_path = (std::filesystem::path(inbox) /
+		(std::string(stamp) + "-" + writer + "-" + std::to_string(sequence++) + SPOOL_EXTENSION)).string();
+	const std::string temp_path = final_path + ".tmp";
+
+	std::string raw;
+	raw.append(feed_url).push_back('\0');
+	raw.append(title).push_back('\0');
+	raw.append(content);
+
+	std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+	if (!file) {
+		std::cerr << "Could not spool announcement to " << inbox << "\n";
+		return false;
+	}
+	bool written = std::fwrite(raw.data(), 1, raw.size(), file) == raw.size();
+	written = std::fclose(file) == 0 && written;
+	if (!written || std::rename(temp_path.c_str(), final_path.c_str()) != 0) {
+		std::cerr << "Could not spool announcement to " << inbox << "\n";
+		std::remove(temp_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+size_t AnnouncementArchive::importSpool(const std::string& inbox) {
+	namespace fs = std::filesystem;
+	std::error_code error;
+
+	std::vector<fs::path> items;
+	for (const auto& entry : fs::directory_iterator(inbox, error)) {
+		if (entry.path().extension() == SPOOL_EXTENSION) {
+			items.push_back(entry.path());
+		}
+	}
+	std::sort(items.begin(), items.end());
+
+	size_t added = 0;
+	for (const auto& item : items) {
+		std::FILE* file = std::fopen(item.c_str(), "rb");
+		if (!file) {
+			continue;
+		}
+		std::string raw;
+		char buffer[8192];
+		size_t length = 0;
+		while ((length = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+			raw.append(buffer, length);
+		}
+		std::fclose(file);
+
+		const size_t title_start = raw.find('\0');
+		const size_t content_start = title_start == std::string::npos ? std::string::npos : raw.find('\0', title_start + 1);
+		if (content_start == std::string::npos) {
+			std::cerr << "Dropping malformed spooled announcement " << item << "\n";
+		}
+		else if (append(raw.substr(0, title_start), raw.substr(title_start + 1, content_start - title_start - 1), raw.substr(content_start + 1))) {
+			++added;
+		}
+		else if (!writable()) {
+			break; // Archive closed after a write error, keep the rest for a later import
+		}
+		fs::remove(item, error);
+	}
+	return added;
+}
+
+std::vector<SearchHit> AnnouncementArchive::search(const std::string& query, size_t limit) {
+	std::vector<std::string> terms = tokenize(query);
+	std::sort(terms.begin(), terms.end());
+	terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+	std::shared_lock<std::shared_mutex> lock(mutex_);
+	if (terms.empty() || documents_.empty() || limit == 0) {
+		return {};
+	}
+
+	const double document_count = static_cast<double>(documents_.size());
+	const double average_length = std::max(1.0, static_cast<double>(total_terms_) / document_count);
+	std::unordered_map<uint32_t, double> scores;
+
+	for (const auto& term : terms) {
+		// Document ranges of the segments and memtables don't overlap, so lists just concatenate
+		std::vector<std::pair<const Posting*, size_t>> lists;
+		for (const auto& segment : segments_) {
+			lists.push_back(segment->find(term));
+		}
+		for (const auto& frozen : frozen_) {
+			auto it = frozen->terms.find(term);
+			if (it != frozen->terms.end()) {
+				lists.emplace_back(it->second.data(), it->second.size());
+			}
+		}
+		auto it = memtable_.find(term);
+		if (it != memtable_.end()) {
+			lists.emplace_back(it->second.data(), it->second.size());
+		}
+
+		size_t frequency = 0;
+		for (const auto& list : lists) {
+			frequency += list.second;
+		}
+		if (frequency == 0) {
+			continue;
+		}
+
+		const double idf = std::log(1.0 + (document_count - frequency + 0.5) / (frequency + 0.5));
+		for (const auto& [postings, count] : lists) {
+			for (size_t i = 0; i < count; ++i) {
+				const Posting& posting = postings[i];
+				const double length = documents_[posting.document].term_count;
+				const double tf = posting.frequency;
+				scores[posting.document] += idf * tf * (BM25_K1 + 1) / (tf + BM25_K1 * (1 - BM25_B + BM25_B * length / average_length));
+			}
+		}
+	}
+
+	// Ties go to the newer announcement
+	std::vector<std::pair<uint32_t, double>> ranked(scores.begin(), scores.end());
+	const size_t count = std::min(limit, ranked.size());
+	std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), [](const auto& a, const auto& b) {
+		return a.second != b.second ? a.second > b.second : a.first > b.first;
+	});
+
+	std::vector<SearchHit> hits;
+	for (size_t i = 0; i < count; ++i) {
+		SearchHit hit;
+		hit.score = ranked[i].second;
+		if (readDocument(ranked[i].first, hit.announcement)) {
+			hit.snippet = makeSnippet(hit.announcement.content, terms);
+			hits.push_back(std::move(hit));
+		}
+	}
+	return hits;
+}
+
+bool AnnouncementArchive::writable() const {
+	std::shared_lock<std::shared_mutex> lock(mutex_);
+	return log_file_ && documents_file_;
+}
+
+size_t AnnouncementArchive::size() const {
+	std::shared_lock<std::shared_mutex> lock(mutex_);
+	return documents_.size();
+}
+
+void AnnouncementArchive::load() {
+	namespace fs = std::filesystem;
+	std::error_code error;
+	fs::create_directories(directory_, error);
+
+	const std::string log_path = path("announcements.log");
+	const std::string documents_path = path("documents.bin");
+
+	if (std::FILE* file = std::fopen(documents_path.c_str(), "rb")) {
+		Document document{};
+		while (std::fread(&document, sizeof(document), 1, file) == 1) {
+			documents_.push_back(document);
+		}
+		std::fclose(file);
+	}
+	log_size_ = fs::exists(log_path, error) ? fs::file_size(log_path, error) : 0;
+
+	// A crash can leave a record without its entry or the reverse, drop the incomplete tail
+	while (!documents_.empty() && documents_.back().offset + documents_.back().record_size > log_size_) {
+		documents_.pop_back();
+	}
+	const uint64_t valid_log_size = documents_.empty() ? 0 : documents_.back().offset + documents_.back().record_size;
+	if (log_size_ > valid_log_size) {
+		fs::resize_file(log_path, valid_log_size, error);
+		log_size_ = valid_log_size;
+	}
+	if (fs::exists(documents_path, error) && fs::file_size(documents_path, error) != documents_.size() * sizeof(Document)) {
+		fs::resize_file(documents_path, documents_.size() * sizeof(Document), error);
+	}
+
+	for (const auto& document : documents_) {
+		keys_.insert(document.key);
+		total_terms_ += document.term_count;
+	}
+
+	log_file_ = std::fopen(log_path.c_str(), "ab");
+	documents_file_ = std::fopen(documents_path.c_str(), "ab");
+	log_fd_ = ::open(log_path.c_str(), O_RDONLY);
+	if (!log_file_ || !documents_file_ || log_fd_ < 0) {
+		std::cerr << "Could not open announcement archive in " << directory_ << ", announcements won't be archived\n";
+	}
+
+	loadSegments();
+
+	// Whatever no segment covers yet was only in the memtable, index it again
+	for (uint32_t id = memtable_first_; id < documents_.size(); ++id) {
+		ArchivedAnnouncement announcement;
+		if (readDocument(id, announcement)) {
+			indexDocument(id, documentTerms(announcement.title, announcement.content));
+		}
+	}
+
+	std::cout << "Loaded " << documents_.size() << " archived announcements from " << directory_
+		<< " (" << segments_.size() << " index segments)\n";
+}
+
+void AnnouncementArchive::loadSegments() {
+	namespace fs = std::filesystem;
+	std::error_code error;
+
+	std::vector<std::unique_ptr<Segment>> found;
+	for (const auto& entry : fs::directory_iterator(directory_, error)) {
+		const std::string name = entry.path().filename().string();
+		if (name.rfind("segment-", 0) != 0) {
+			continue;
+		}
+		if (entry.path().extension() == ".idx") {
+			if (auto segment = Segment::open(entry.path().string())) {
+				found.push_back(std::move(segment));
+				continue;
+			}
+		}
+		fs::remove(entry.path(), error); // Unfinished write or unreadable
+	}
+
+	// Keep a contiguous run from the first document. A merge that crashed before deleting its
+	// inputs leaves segments the merged one covers, and a segment past the end of the
+	// documents refers to records that were dropped.
+	std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+		return a->first() != b->first() ? a->first() < b->first() : a->end() > b->end();
+	});
+	for (auto& segment : found) {
+		if (segment->first() == memtable_first_ && segment->end() <= documents_.size()) {
+			memtable_first_ = segment->end();
+			segments_.push_back(std::move(segment));
+		}
+		else {
+			const std::string stale = segment->path();
+			segment.reset();
+			fs::remove(stale, error);
+		}
+	}
+}
+
+void AnnouncementArchive::indexDocument(uint32_t document, const std::vector<std::string>& terms) {
+	std::unordered_map<std::string_view, uint32_t> frequencies;
+	for (const auto& term : terms) {
+		++frequencies[term];
+	}
+	for (const auto& [term, frequency] : frequencies) {
+		auto it = memtable_.find(term);
+		if (it == memtable_.end()) {
+			it = memtable_.emplace(std::string(term), std::vector<Posting>{}).first;
+		}
+		it->second.push_back(Posting{ document, frequency });
+	}
+}
+
+// Size tier of a segment: MEMTABLE_DOCUMENTS * MERGE_FACTOR^tier documents or more
+static size_t segmentTier(uint32_t documents) {
+	size_t tier = 0;
+	for (uint64_t size = AnnouncementArchive::MEMTABLE_DOCUMENTS * AnnouncementArchive::MERGE_FACTOR; documents >= size; size *= AnnouncementArchive::MERGE_FACTOR) {
+		++tier;
+	}
+	return tier;
+}
+
+// Called with mutex_ held exclusively. The memtable stays searchable until its segment is written.
+void AnnouncementArchive::freezeMemtable() {
+	auto frozen = std::make_shared<FrozenMemtable>();
+	frozen->first = memtable_first_;
+	frozen->end = static_cast<uint32_t>(documents_.size());
+	frozen->terms = std::move(memtable_);
+	memtable_.clear();
+
+	frozen_.push_back(std::move(frozen));
+	memtable_first_ = static_cast<uint32_t>(documents_.size());
+}
+
+// Called without mutex_. Segments are built from immutable inputs with no lock held, then
+// swapped in under the exclusive lock. Only the thread holding maintenance_mutex_ changes
+// segments_ and frozen_'s head, so they are still in place when it swaps.
+void AnnouncementArchive::maintainSegments() {
+	std::lock_guard<std::mutex> maintenance(maintenance_mutex_);
+	if (!flushFrozen()) {
+		return;
+	}
+	while (mergeTier()) {
+	}
+}
+
+// Writes every frozen memtable out as a segment, oldest first. On failure the rest stay in
+// memory and are retried after the next freeze.
+bool AnnouncementArchive::flushFrozen() {
+	while (true) {
+		std::shared_ptr<const FrozenMemtable> frozen;
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex_);
+			if (frozen_.empty()) {
+				return true;
+			}
+			frozen = frozen_.front();
+		}
+
+		std::vector<std::pair<std::string, std::vector<Posting>>> terms(frozen->terms.begin(), frozen->terms.end());
+		std::shared_ptr<const Segment> segment = writeSegment(frozen->first, frozen->end, terms);
+		if (!segment) {
+			return false;
+		}
+
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+		frozen_.erase(frozen_.begin());
+		segments_.push_back(std::move(segment));
+	}
+}
+
+// Merges the oldest run of MERGE_FACTOR adjacent segments that share a tier. Returns whether
+// it merged anything, a merge can complete a run in the next tier.
+bool AnnouncementArchive::mergeTier() {
+	std::vector<std::shared_ptr<const Segment>> segments;
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex_);
+		segments = segments_;
+	}
+
+	// Oldest run first, so a leftover segment merges with the ones after it instead of being
+	// stranded between larger segments
+	size_t start = 0;
+	size_t run = 0;
+	for (size_t i = 0; i < segments.size() && run < MERGE_FACTOR; ++i) {
+		const size_t tier = segmentTier(segments[i]->end() - segments[i]->first());
+		if (run == 0 || tier != segmentTier(segments[start]->end() - segments[start]->first())) {
+			start = i;
+			run = 0;
+		}
+		++run;
+	}
+	if (run < MERGE_FACTOR) {
+		return false;
+	}
+
+	const std::vector<std::shared_ptr<const Segment>> inputs(segments.begin() + start, segments.begin() + start + MERGE_FACTOR);
+	std::shared_ptr<const Segment> merged = mergeSegments(inputs);
+	if (!merged) {
+		return false;
+	}
+
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+		segments_.erase(segments_.begin() + start, segments_.begin() + start + MERGE_FACTOR);
+		segments_.insert(segments_.begin() + start, std::move(merged));
+	}
+
+	// Searches that already hold an input keep its mapping, removing the file doesn't affect it
+	std::error_code error;
+	for (const auto& old : inputs) {
+		std::filesystem::remove(old->path(), error);
+	}
+	return true;
+}
+
+// K-way merge of the sorted term tables. Inputs are ordered by document range, so each
+// merged posting list stays sorted by document.
+std::shared_ptr<const AnnouncementArchive::Segment> AnnouncementArchive::mergeSegments(const std::vector<std::shared_ptr<const Segment>>& inputs) {
+	std::vector<std::pair<std::string, std::vector<Posting>>> merged;
+	std::vector<size_t> cursors(inputs.size(), 0);
+
+	while (true) {
+		std::string_view smallest;
+		bool any = false;
+		for (size_t i = 0; i < inputs.size(); ++i) {
+			if (cursors[i] < inputs[i]->termCount()) {
+				const std::string_view term = inputs[i]->termAt(cursors[i]);
+				if (!any || term < smallest) {
+					smallest = term;
+					any = true;
+				}
+			}
+		}
+		if (!any) {
+			break;
+		}
+
+		auto& [term, postings] = merged.emplace_back(std::string(smallest), std::vector<Posting>{});
+		for (size_t i = 0; i < inputs.size(); ++i) {
+			if (cursors[i] < inputs[i]->termCount() && inputs[i]->termAt(cursors[i]) == term) {
+				const auto [list, count] = inputs[i]->postingsAt(cursors[i]);
+				postings.insert(postings.end(), list, list + count);
+				++cursors[i];
+			}
+		}
+	}
+
+	return writeSegment(inputs.front()->first(), inputs.back()->end(), merged);
+}
+
+std::unique_ptr<AnnouncementArchive::Segment> AnnouncementArchive::writeSegment(uint32_t first, uint32_t end,
+	const std::vector<std::pair<std::string, std::vector<Posting>>>& terms) {
+	const std::string final_path = path("segment-" + std::to_string(first) + "-" + std::to_string(end) + ".idx");
+	const std::string temp_path = final_path + ".tmp";
+
+	SegmentHeader header{};
+	header.magic = SEGMENT_MAGIC;
+	header.first_document = first;
+	header.end_document = end;
+	header.term_count = static_cast<uint32_t>(terms.size());
+
+	std::vector<TermEntry> entries;
+	entries.reserve(terms.size());
+	uint32_t postings_offset = 0;
+	for (const auto& [term, postings] : terms) {
+		entries.push_back(TermEntry{ header.strings_size, static_cast<uint32_t>(term.size()), postings_offset, static_cast<uint32_t>(postings.size()) });
+		header.strings_size += static_cast<uint32_t>(term.size());
+		postings_offset += static_cast<uint32_t>(postings.size());
+	}
+
+	std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+	if (!file) {
+		std::cerr << "Could not write index segment " << temp_path << "\n";
+		return nullptr;
+	}
+
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		std::fwrite(entries.data(), sizeof(TermEntry), entries.size(), file) == entries.size();
+	for (const auto& [term, postings] : terms) {
+		written = written && std::fwrite(term.data(), 1, term.size(), file) == term.size();
+	}
+	const size_t padding = (4 - (sizeof(header) + entries.size() * sizeof(TermEntry) + header.strings_size) % 4) % 4;
+	const char zeros[4] = {};
+	written = written && std::fwrite(zeros, 1, padding, file) == padding;
+	for (const auto& [term, postings] : terms) {
+		written = written && std::fwrite(postings.data(), sizeof(Posting), postings.size(), file) == postings.size();
+	}
+	written = std::fclose(file) == 0 && written;
+
+	if (!written || std::rename(temp_path.c_str(), final_path.c_str()) != 0) {
+		std::cerr << "Could not write index segment " << final_path << "\n";
+		std::remove(temp_path.c_str());
+		return nullptr;
+	}
+	return Segment::open(final_path);
+}
+
+bool AnnouncementArchive::readDocument(uint32_t document, ArchivedAnnouncement& announcement) const {
+	if (log_fd_ < 0 || document >= documents_.size()) {
+		return false;
+	}
+
+	const Document& entry = documents_[document];
+	RecordHeader header{};
+	if (pread(log_fd_, &header, sizeof(header), static_cast<off_t>(entry.offset)) != static_cast<ssize_t>(sizeof(header)) ||
+		header.magic != RECORD_MAGIC || sizeof(header) + header.compressed_size != entry.record_size) {
+		return false;
+	}
+
+	std::vector<Bytef> compressed(header.compressed_size);
+	if (pread(log_fd_, compressed.data(), compressed.size(), static_cast<off_t>(entry.offset + sizeof(header))) != static_cast<ssize_t>(compressed.size())) {
+		return false;
+	}
+
+	std::string raw(header.raw_size, '\0');
+	uLongf raw_size = header.raw_size;
+	if (uncompress(reinterpret_cast<Bytef*>(raw.data()), &raw_size, compressed.data(), compressed.size()) != Z_OK || raw_size != header.raw_size) {
+		return false;
+	}
+
+	const size_t title_start = raw.find('\0');
+	const size_t content_start = title_start == std::string::npos ? std::string::npos : raw.find('\0', title_start + 1);
+	if (content_start == std::string::npos) {
+		return false;
+	}
+
+	announcement.feed_url = raw.substr(0, title_start);
+	announcement.title = raw.substr(title_start + 1, content_start - title_start - 1);
+	announcement.content = raw.substr(content_start + 1);
+	announcement.archived_at = header.archived_at;
+	return true;
+}
+
+std::string AnnouncementArchive::path(const std::string& name) const {
+	return (std::filesystem::path(directory_) / name).string();
+}
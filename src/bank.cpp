@@ -0,0 +1,235 @@
+#include "include/bank.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// On disk every record is user (8 bytes), balance delta (8 bytes) and escrow ID (8 bytes), host
+// byte order. With an escrow ID a negative delta moves coins into that escrow, and user 0 with
+// delta 0 marks it settled.
+constexpr size_t RECORD_SIZE = 24;
+
+Bank::Bank(const std::string& persist_path) : persist_path_(persist_path) {
+	load();
+	{
+		std::unique_lock<std::shared_mutex> lock(persist_mutex_);
+		compact();
+	}
+	if (!persist_file_) {
+		persist_file_ = std::fopen(persist_path_.c_str(), "ab");
+	}
+	if (!persist_file_) {
+		std::cerr << "Could not open bank file: " << persist_path_ << ", balances won't survive restarts\n";
+	}
+}
+
+Bank::~Bank() {
+	if (persist_file_) {
+		std::fclose(persist_file_);
+	}
+}
+
+int64_t Bank::balance(uint64_t user) {
+	Shard& shard = shards_[user % SHARDS];
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto it = shard.accounts.find(user);
+	return it == shard.accounts.end() ? STARTING_BALANCE : it->second.load();
+}
+
+void Bank::deposit(uint64_t user, int64_t amount) {
+	{
+		std::shared_lock<std::shared_mutex> lock(persist_mutex_);
+		account(user).fetch_add(amount);
+		append(user, amount);
+	}
+	compactIfDue();
+}
+
+bool Bank::withdraw(uint64_t user, int64_t amount, uint64_t escrow) {
+	if (amount < 0) {
+		return false;
+	}
+
+	{
+		std::shared_lock<std::shared_mutex> lock(persist_mutex_);
+		std::atomic<int64_t>& balance = account(user);
+		int64_t current = balance.load();
+		do {
+			if (current < amount) {
+				return false;
+			}
+		} while (!balance.compare_exchange_weak(current, current - amount));
+		if (escrow != 0) {
+			std::lock_guard<std::mutex> escrow_lock(escrow_mutex_);
+			escrows_[escrow].emplace_back(user, amount);
+		}
+		append(user, -amount, escrow);
+	}
+	compactIfDue();
+	return true;
+}
+
+void Bank::settle(uint64_t escrow) {
+	{
+		std::shared_lock<std::shared_mutex> lock(persist_mutex_);
+		{
+			std::lock_guard<std::mutex> escrow_lock(escrow_mutex_);
+			if (escrows_.erase(escrow) == 0) {
+				return;
+			}
+		}
+		append(0, 0, escrow);
+	}
+	compactIfDue();
+}
+
+// unordered_map nodes never move, so the returned reference stays valid without the lock
+std::atomic<int64_t>& Bank::account(uint64_t user) {
+	Shard& shard = shards_[user % SHARDS];
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	return shard.accounts.try_emplace(user, STARTING_BALANCE).first->second;
+}
+
+static void encodeRecord(unsigned char* record, uint64_t user, int64_t delta, uint64_t escrow = 0) {
+	std::memcpy(record, &user, sizeof(user));
+	std::memcpy(record + 8, &delta, sizeof(delta));
+	std::memcpy(record + 16, &escrow, sizeof(escrow));
+}
+
+// Called with persist_mutex_ held shared, stdio locks the file for the write itself
+void Bank::append(uint64_t user, int64_t delta, uint64_t escrow) {
+	if (!persist_file_) {
+		return;
+	}
+
+	unsigned char record[RECORD_SIZE];
+	encodeRecord(record, user, delta, escrow);
+	if (std::fwrite(record, 1, RECORD_SIZE, persist_file_) != RECORD_SIZE || std::fflush(persist_file_) != 0) {
+		std::cerr << "Could not append to bank file: " << persist_path_ << "\n";
+		return;
+	}
+	++log_records_;
+}
+
+// Replays the log on top of STARTING_BALANCE and refunds every escrow that was never settled,
+// those games ended with the bot. The constructor then compacts the log.
+void Bank::load() {
+	std::FILE* file = std::fopen(persist_path_.c_str(), "rb");
+	if (!file) {
+		return;
+	}
+
+	unsigned char record[RECORD_SIZE];
+	size_t records = 0;
+	while (std::fread(record, 1, RECORD_SIZE, file) == RECORD_SIZE) {
+		uint64_t user = 0;
+		int64_t delta = 0;
+		uint64_t escrow = 0;
+		std::memcpy(&user, record, sizeof(user));
+		std::memcpy(&delta, record + 8, sizeof(delta));
+		std::memcpy(&escrow, record + 16, sizeof(escrow));
+		if (escrow != 0 && delta < 0) {
+			escrows_[escrow].emplace_back(user, -delta);
+		}
+		else if (escrow != 0) {
+			escrows_.erase(escrow);
+		}
+		if (user != 0) {
+			account(user).fetch_add(delta);
+		}
+		++records;
+	}
+	std::fclose(file);
+
+	size_t accounts = 0;
+	for (auto& shard : shards_) {
+		accounts += shard.accounts.size();
+	}
+	std::cout << "Restored " << accounts << " bank accounts from " << records << " records in " << persist_path_ << "\n";
+
+	int64_t refunded = 0;
+	for (const auto& [escrow, payments] : escrows_) {
+		for (const auto& [payer, amount] : payments) {
+			account(payer).fetch_add(amount);
+			refunded += amount;
+		}
+	}
+	if (!escrows_.empty()) {
+		std::cout << "Refunded " << refunded << " coins held by " << escrows_.size() << " unfinished games\n";
+	}
+	escrows_.clear();
+}
+
+void Bank::compactIfDue() {
+	if (log_records_.load() < compact_at_) {
+		return;
+	}
+
+	std::unique_lock<std::shared_mutex> lock(persist_mutex_);
+	// Another thread may have compacted while this one waited
+	if (log_records_.load() >= compact_at_ && !compact()) {
+		compact_at_ = log_records_.load() * 2; // Back off instead of retrying on every change
+	}
+}
+
+// Writes one record per account to a temporary file and renames it over the log. Open escrows
+// are written as their payer's coins coming back and going into escrow again, so the balances
+// stay the same. The old log is kept unless every write, the flush and the close succeeded.
+bool Bank::compact() {
+	std::vector<unsigned char> records;
+	for (auto& shard : shards_) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		for (const auto& [user, balance] : shard.accounts) {
+			if (balance.load() != STARTING_BALANCE) {
+				records.resize(records.size() + RECORD_SIZE);
+				encodeRecord(records.data() + records.size() - RECORD_SIZE, user, balance.load() - STARTING_BALANCE);
+			}
+		}
+	}
+	{
+		std::lock_guard<std::mutex> escrow_lock(escrow_mutex_);
+		for (const auto& [escrow, payments] : escrows_) {
+			for (const auto& [payer, amount] : payments) {
+				records.resize(records.size() + 2 * RECORD_SIZE);
+				encodeRecord(records.data() + records.size() - 2 * RECORD_SIZE, payer, amount);
+				encodeRecord(records.data() + records.size() - RECORD_SIZE, payer, -amount, escrow);
+			}
+		}
+	}
+
+	const std::string compacted_path = persist_path_ + ".tmp";
+	std::FILE* compacted = std::fopen(compacted_path.c_str(), "wb");
+	if (!compacted) {
+		std::cerr << "Could not compact bank file: " << persist_path_ << "\n";
+		return false;
+	}
+	bool written = records.empty() || std::fwrite(records.data(), 1, records.size(), compacted) == records.size();
+	written = std::fflush(compacted) == 0 && written;
+	written = fsync(fileno(compacted)) == 0 && written;
+	written = std::fclose(compacted) == 0 && written;
+	if (!written) {
+		std::cerr << "Could not compact bank file: " << persist_path_ << ", keeping the old one\n";
+		std::remove(compacted_path.c_str());
+		return false;
+	}
+
+	if (persist_file_) {
+		std::fclose(persist_file_);
+		persist_file_ = nullptr;
+	}
+	const bool renamed = std::rename(compacted_path.c_str(), persist_path_.c_str()) == 0;
+	if (!renamed) {
+		std::remove(compacted_path.c_str());
+	}
+	persist_file_ = std::fopen(persist_path_.c_str(), "ab");
+	if (!persist_file_) {
+		std::cerr << "Could not reopen bank file: " << persist_path_ << ", balance changes aren't saved\n";
+	}
+
+	if (renamed) {
+		log_records_ = records.size() / RECORD_SIZE;
+		compact_at_ = std::max(MIN_COMPACT_RECORDS, log_records_.load() * 2);
+	}
+	return renamed;
+}
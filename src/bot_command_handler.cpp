@@ -1,6 +1,79 @@
 #include "include/bot_command_handler.h"
+#include <array>
+#include <algorithm>
 
-bot_command_handler::bot_command_handler(dpp::cluster& bot) : bot(bot) {}
+// Discord rejects message content longer than this
+constexpr size_t MAX_REPLY_LENGTH = 2000;
+
+// Reply when the snapshot is empty, before the first poll finishes or for a course without gradable assignments
+constexpr const char* NO_ASSIGNMENTS_TRACKED = "No assignments are tracked yet. Canvas may not have been checked since the bot started.";
+
+// How long a game waits for the next button click before the wagers are refunded
+constexpr auto GAME_SESSION_TTL = std::chrono::seconds(120);
+
+constexpr const char* GAME_BUTTON_PREFIX = "game:";
+
+constexpr const char* BANK_FILE = "config/bank.bin";
+constexpr const char* COOLDOWN_FILE = "config/cooldowns.bin";
+constexpr auto DAILY_COOLDOWN = std::chrono::hours(24);
+constexpr auto WORK_COOLDOWN = std::chrono::hours(1);
+constexpr auto WAGER_COOLDOWN = std::chrono::seconds(5);
+constexpr int64_t DAILY_REWARD = 100;
+constexpr size_t SEARCH_RESULTS = 5;
+constexpr size_t MAX_TITLE_LENGTH = 256;
+constexpr std::array<const char*, 3> RPS_MOVES = { "rock", "paper", "scissors" };
+
+static std::string format_duration(std::chrono::seconds duration) {
+    const auto hours = std::chrono::duration_cast<std::chrono::hours>(duration);
+    const auto minutes = std::chrono::duration_cast<std::chrono::minutes>(duration - hours);
+    const auto seconds = duration - hours - minutes;
+
+    std::string result;
+    if (hours.count() > 0) {
+        result += std::to_string(hours.count()) + "h ";
+    }
+    if (hours.count() > 0 || minutes.count() > 0) {
+        result += std::to_string(minutes.count()) + "m ";
+    }
+    return result + std::to_string(seconds.count()) + "s";
+}
+
+static std::string mention(uint64_t user) {
+    return "<@" + std::to_string(user) + ">";
+}
+
+static int roll_die() {
+    return std::uniform_int_distribution<int>(1, 6)(thread_rng());
+}
+
+static dpp::component game_button(const std::string& label, uint64_t session_id, const std::string& action, dpp::component_style style) {
+    return dpp::component()
+        .set_type(dpp::cot_button)
+        .set_label(label)
+        .set_style(style)
+        .set_id(GAME_BUTTON_PREFIX + std::to_string(session_id) + ":" + action);
+}
+
+static dpp::component rps_buttons(uint64_t session_id) {
+    return dpp::component()
+        .add_component(game_button("Rock", session_id, "rock", dpp::cos_primary))
+        .add_component(game_button("Paper", session_id, "paper", dpp::cos_primary))
+        .add_component(game_button("Scissors", session_id, "scissors", dpp::cos_primary));
+}
+
+static void reply_ephemeral(const dpp::button_click_t& event, const std::string& content) {
+    event.reply(dpp::message(content).set_flags(dpp::m_ephemeral));
+}
+
+// Replaces the game message, dropping its buttons
+static void finish_game(const dpp::button_click_t& event, const std::string& content) {
+    event.reply(dpp::ir_update_message, dpp::message(content));
+}
+
+bot_command_handler::bot_command_handler(dpp::cluster& bot, CanvasHandler& canvas, AnnouncementArchive& archive)
+    : bot(bot), canvas(canvas), archive(archive), bank(BANK_FILE), sessions(bank), cooldowns(COOLDOWN_FILE) {
+    sessions.start();
+}
 
 void bot_command_handler::handle(const dpp::slashcommand_t& event) {
     const std::string& command = event.command.get_command_name();
@@ -25,37 +98,154 @@ void bot_command_handler::handle(const dpp::slashcommand_t& event) {
         handle_work(event);
     } else if (command == "daily") {
         handle_daily(event);
+    } else if (command == "assignments") {
+        handle_assignments(event);
+    } else if (command == "grades") {
+        handle_grades(event);
+    } else if (command == "search") {
+        handle_search(event);
     } else {
         event.reply("Unknown command.");
     }
 }
 
+void bot_command_handler::handle_button(const dpp::button_click_t& event) {
+    const std::string& custom_id = event.custom_id;
+    if (custom_id.rfind(GAME_BUTTON_PREFIX, 0) != 0) {
+        return;
+    }
+
+    // custom_id is "game:<session id>:<action>"
+    const size_t id_start = std::char_traits<char>::length(GAME_BUTTON_PREFIX);
+    const size_t separator = custom_id.find(':', id_start);
+    if (separator == std::string::npos) {
+        return;
+    }
+
+    uint64_t session_id = 0;
+    try {
+        session_id = std::stoull(custom_id.substr(id_start, separator - id_start));
+    } catch (const std::exception&) {
+        return;
+    }
+    const std::string action = custom_id.substr(separator + 1);
+    const uint64_t player = event.command.usr.id;
+
+    bool found = sessions.update(session_id, [&](GameSession& session) {
+        if (session.opponent != 0 && !session.accepted) {
+            return accept_challenge(event, session, action, player);
+        }
+        return play_move(event, session, action, player);
+    });
+
+    if (!found) {
+        reply_ephemeral(event, "This game has already finished or expired.");
+    }
+}
+
 // TODO: Implement w/ coroutines
 void bot_command_handler::handle_balance(const dpp::slashcommand_t& event) {
-    event.reply("Balance command not implemented yet.");
+    uint64_t user = event.command.usr.id;
+    auto user_param = event.get_parameter("user");
+    if (auto snowflake = std::get_if<dpp::snowflake>(&user_param)) {
+        user = *snowflake;
+    }
+    event.reply(mention(user) + " has " + std::to_string(bank.balance(user)) + " coins.");
 }
 
 void bot_command_handler::handle_dice(const dpp::slashcommand_t& event) {
-    int amount = std::get<long int>(event.get_parameter("amount"));
+    int64_t amount = std::get<int64_t>(event.get_parameter("amount"));
+    uint64_t user = event.command.usr.id;
 
     auto user_id = event.get_parameter("user");
     if (auto snowflake = std::get_if<dpp::snowflake>(&user_id)) {
-        event.reply("You challenged <@" + std::to_string(*snowflake) + "> to roll a dice for " + std::to_string(amount) + " coins!");
+        if (open_game(event, GameKind::Dice, amount, *snowflake)) {
+            dpp::message msg(mention(*snowflake) + ", " + mention(user) + " challenged you to roll a dice for " + std::to_string(amount) + " coins!");
+            msg.add_component(dpp::component()
+                .add_component(game_button("Accept", event.command.id, "accept", dpp::cos_success))
+                .add_component(game_button("Decline", event.command.id, "decline", dpp::cos_danger)));
+            msg.allowed_mentions.parse_users = true;
+            event.reply(msg);
+        }
+        return;
+    }
+
+    // Against the house the roll is immediate, no session needed
+    if (!take_wager(event, amount, 0, 0)) {
+        return;
+    }
+
+    const int player_roll = roll_die() + roll_die();
+    const int house_roll = roll_die() + roll_die();
+    std::string result = "You rolled " + std::to_string(player_roll) + ", the house rolled " + std::to_string(house_roll) + ". ";
+    if (player_roll > house_roll) {
+        bank.deposit(user, amount * 2);
+        result += "You won " + std::to_string(amount) + " coins!";
+    } else if (player_roll == house_roll) {
+        bank.deposit(user, amount);
+        result += "It's a tie, your coins were returned.";
     } else {
-        event.reply("You rolled the dice for " + std::to_string(amount) + " coins!");
+        result += "You lost " + std::to_string(amount) + " coins.";
     }
+    event.reply(result);
 }
 
 void bot_command_handler::handle_rps(const dpp::slashcommand_t& event) {
-    event.reply("Rock, Paper, Scissors command not implemented yet");
+    int64_t amount = std::get<int64_t>(event.get_parameter("amount"));
+    uint64_t user = event.command.usr.id;
+
+    auto user_id = event.get_parameter("user");
+    uint64_t opponent = 0;
+    if (auto snowflake = std::get_if<dpp::snowflake>(&user_id)) {
+        opponent = *snowflake;
+    }
+
+    if (!open_game(event, GameKind::RockPaperScissors, amount, opponent)) {
+        return;
+    }
+
+    if (opponent != 0) {
+        dpp::message msg(mention(opponent) + ", " + mention(user) + " challenged you to Rock, Paper, Scissors for " + std::to_string(amount) + " coins!");
+        msg.add_component(dpp::component()
+            .add_component(game_button("Accept", event.command.id, "accept", dpp::cos_success))
+            .add_component(game_button("Decline", event.command.id, "decline", dpp::cos_danger)));
+        msg.allowed_mentions.parse_users = true;
+        event.reply(msg);
+    } else {
+        dpp::message msg("Rock, Paper, Scissors for " + std::to_string(amount) + " coins, pick your move!");
+        msg.add_component(rps_buttons(event.command.id));
+        event.reply(msg);
+    }
 }
 
 void bot_command_handler::handle_roulette(const dpp::slashcommand_t& event) {
-    event.reply("Roulette command not implemented yet");
+    int64_t amount = std::get<int64_t>(event.get_parameter("amount"));
+    if (!open_game(event, GameKind::Roulette, amount, 0)) {
+        return;
+    }
+
+    dpp::message msg("Roulette for " + std::to_string(amount) + " coins. Red or black pays 2x, green pays 36x. Place your bet!");
+    msg.add_component(dpp::component()
+        .add_component(game_button("Red", event.command.id, "red", dpp::cos_danger))
+        .add_component(game_button("Black", event.command.id, "black", dpp::cos_secondary))
+        .add_component(game_button("Green", event.command.id, "green", dpp::cos_success)));
+    event.reply(msg);
 }
 
 void bot_command_handler::handle_guess(const dpp::slashcommand_t& event) {
-    event.reply("Guess command not implemented yet");
+    int64_t amount = std::get<int64_t>(event.get_parameter("amount"));
+    if (!open_game(event, GameKind::Guess, amount, 0)) {
+        return;
+    }
+
+    dpp::component row;
+    for (int number = 1; number <= 5; ++number) {
+        row.add_component(game_button(std::to_string(number), event.command.id, std::to_string(number), dpp::cos_primary));
+    }
+
+    dpp::message msg("I'm thinking of a number from 1 to 5. Guess it for 4x your " + std::to_string(amount) + " coins!");
+    msg.add_component(row);
+    event.reply(msg);
 }
 
 void bot_command_handler::handle_market(const dpp::slashcommand_t& event) {
@@ -72,18 +262,376 @@ void bot_command_handler::handle_richest(const dpp::slashcommand_t& event) {
 
 void bot_command_handler::handle_work(const dpp::slashcommand_t& event) {
     std::string job = std::get<std::string>(event.get_parameter("job"));
+    if (job != "construction_work" && job != "office_job" && job != "startup_founder") {
+        event.reply("Invalid job --- You wasted your time!");
+        return;
+    }
+
+    if (!check_cooldown(event, CooldownCommand::Work, WORK_COOLDOWN)) {
+        return;
+    }
 
+    const uint64_t user = event.command.usr.id;
     if (job == "construction_work") {
-        event.reply("You worked in construction, you feel tired but made XYZ");
+        const int64_t pay = std::uniform_int_distribution<int64_t>(50, 100)(thread_rng());
+        bank.deposit(user, pay);
+        event.reply("You worked in construction, you feel tired but made " + std::to_string(pay) + " coins");
     } else if (job == "office_job") {
-        event.reply("You worked an office job, it's not difficult and you made XYZ");
-    } else if (job == "startup_founder") {
-        event.reply("You took a risky gamble as a startup founder and earned nothing!");
+        const int64_t pay = std::uniform_int_distribution<int64_t>(30, 60)(thread_rng());
+        bank.deposit(user, pay);
+        event.reply("You worked an office job, it's not difficult and you made " + std::to_string(pay) + " coins");
     } else {
-        event.reply("Invalid job --- You wasted your time!");
+        event.reply("You took a risky gamble as a startup founder and earned nothing!");
     }
 }
 
 void bot_command_handler::handle_daily(const dpp::slashcommand_t& event) {
-    event.reply("Daily reward not implemented yet");
+    if (!check_cooldown(event, CooldownCommand::Daily, DAILY_COOLDOWN)) {
+        return;
+    }
+
+    bank.deposit(event.command.usr.id, DAILY_REWARD);
+    event.reply("You claimed your daily " + std::to_string(DAILY_REWARD) + " coins!");
+}
+
+bool bot_command_handler::check_cooldown(const dpp::slashcommand_t& event, CooldownCommand command, std::chrono::seconds cooldown) {
+    std::chrono::seconds remaining;
+    if (cooldowns.tryAcquire(event.command.usr.id, command, cooldown, remaining)) {
+        return true;
+    }
+    event.reply(dpp::message("Slow down! You can use this again in " + format_duration(remaining) + ".").set_flags(dpp::m_ephemeral));
+    return false;
+}
+
+
+// Appends line unless that would push the reply past Discord's limit
+static bool append_line(std::string& reply, const std::string& line) {
+    if (reply.size() + line.size() + 1 > MAX_REPLY_LENGTH - 16) {
+        return false;
+    }
+    reply += line + "\n";
+    return true;
+}
+
+// Both commands answer from CanvasHandler's published snapshot, so they never hit Canvas
+void bot_command_handler::handle_assignments(const dpp::slashcommand_t& event) {
+    auto snapshot = canvas.snapshot();
+    if (snapshot->assignments.empty()) {
+        event.reply(NO_ASSIGNMENTS_TRACKED);
+        return;
+    }
+
+    std::string reply = "**Assignments still awaiting grades:**\n";
+    size_t count = 0;
+    for (const auto& assignment : snapshot->assignments) {
+        if (assignment.graded) {
+            continue;
+        }
+        if (!append_line(reply, "- " + std::string(assignment.name))) {
+            reply += "...";
+            break;
+        }
+        ++count;
+    }
+
+    if (count == 0) {
+        reply = "Every tracked assignment has been graded.";
+    }
+    event.reply(reply);
+}
+
+void bot_command_handler::handle_grades(const dpp::slashcommand_t& event) {
+    auto snapshot = canvas.snapshot();
+    if (snapshot->assignments.empty()) {
+        event.reply(NO_ASSIGNMENTS_TRACKED);
+        return;
+    }
+
+    std::string reply = "**Assignments with released grades:**\n";
+    size_t count = 0;
+    for (const auto& assignment : snapshot->assignments) {
+        if (!assignment.graded) {
+            continue;
+        }
+        std::string line = "- " + std::string(assignment.name);
+        if (assignment.graded_at != 0) {
+            line += " (<t:" + std::to_string(assignment.graded_at) + ":R>)";
+        }
+        if (!append_line(reply, line)) {
+            reply += "...";
+            break;
+        }
+        ++count;
+    }
+
+    if (count == 0) {
+        reply = "No grades have been released yet.";
+    }
+    event.reply(reply);
+}
+
+// Echoed user input and feed content, a zero width space after every @ keeps it from pinging anyone
+static std::string without_mentions(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        escaped += c;
+        if (c == '@') {
+            escaped += "\u200b";
+        }
+    }
+    return escaped;
+}
+
+// Cuts text to at most max_length bytes without splitting a UTF-8 sequence, marking the cut with "..."
+static std::string truncate_utf8(const std::string& text, size_t max_length) {
+    if (text.size() <= max_length) {
+        return text;
+    }
+    if (max_length < 3) {
+        return "";
+    }
+    size_t end = max_length - 3;
+    while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+        --end;
+    }
+    return text.substr(0, end) + "...";
+}
+
+// Ranked lookup in the announcement archive, only the matching records are read from disk
+void bot_command_handler::handle_search(const dpp::slashcommand_t& event) {
+    const std::string query = std::get<std::string>(event.get_parameter("query"));
+    const std::string shown_query = without_mentions(query);
+
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<SearchHit> hits = archive.search(query, SEARCH_RESULTS);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+
+    std::string reply;
+    if (hits.empty()) {
+        reply = "No announcements match \"" + shown_query + "\".";
+    } else {
+        reply = "**Announcements matching \"" + shown_query + "\"** (" + std::to_string(elapsed.count()) + " ms):\n";
+        for (const auto& hit : hits) {
+            const std::string heading = "- **" + truncate_utf8(without_mentions(hit.announcement.title), MAX_TITLE_LENGTH) + "** (<t:" + std::to_string(hit.announcement.archived_at) + ":d>) <" +
+                hit.announcement.feed_url + ">\n  ";
+            const std::string snippet = without_mentions(hit.snippet);
+            if (append_line(reply, heading + snippet)) {
+                continue;
+            }
+
+            // Out of room, shorten this hit's snippet to fill what is left and stop there
+            const size_t room = MAX_REPLY_LENGTH - 16 - reply.size() - 1;
+            if (heading.size() < room) {
+                append_line(reply, heading + truncate_utf8(snippet, room - heading.size()));
+            }
+            break;
+        }
+    }
+
+    // Titles and snippets come from feeds, never let them ping anyone even if an escape is missed
+    event.reply(dpp::message(reply).set_allowed_mentions(false, false, false, false, {}, {}));
+}
+
+// Validates the bet and debits it. The wager cooldown is only started once the bet is taken,
+// so a mistyped amount or a bet the user can't afford doesn't lock them out.
+bool bot_command_handler::take_wager(const dpp::slashcommand_t& event, int64_t amount, uint64_t opponent, uint64_t escrow) {
+    const uint64_t user = event.command.usr.id;
+
+    if (amount <= 0) {
+        event.reply("The amount has to be positive.");
+        return false;
+    }
+    if (opponent == user) {
+        event.reply("You can't challenge yourself.");
+        return false;
+    }
+    if (!bank.withdraw(user, amount, escrow)) {
+        event.reply("You don't have enough coins for that.");
+        return false;
+    }
+    if (!check_cooldown(event, CooldownCommand::Wager, WAGER_COOLDOWN)) {
+        bank.deposit(user, amount);
+        bank.settle(escrow);
+        return false;
+    }
+    return true;
+}
+
+// Moves the challenger's wager into escrow and registers the session under the command's interaction ID
+bool bot_command_handler::open_game(const dpp::slashcommand_t& event, GameKind kind, int64_t amount, uint64_t opponent) {
+    const uint64_t user = event.command.usr.id;
+    if (!take_wager(event, amount, opponent, event.command.id)) {
+        return false;
+    }
+
+    GameSession session;
+    session.id = event.command.id;
+    session.kind = kind;
+    session.challenger = user;
+    session.opponent = opponent;
+    session.wager = amount;
+    session.escrow = amount;
+    sessions.open(session, GAME_SESSION_TTL);
+    return true;
+}
+
+// Handles Accept/Decline on a pending challenge. Returns true when the session is done.
+bool bot_command_handler::accept_challenge(const dpp::button_click_t& event, GameSession& session, const std::string& action, uint64_t player) {
+    if (action == "decline" && (player == session.opponent || player == session.challenger)) {
+        bank.deposit(session.challenger, session.escrow);
+        session.escrow = 0;
+        finish_game(event, mention(player) + (player == session.challenger ? " withdrew the challenge." : " declined the challenge."));
+        return true;
+    }
+
+    if (action != "accept" || player != session.opponent) {
+        reply_ephemeral(event, "This challenge isn't for you.");
+        return false;
+    }
+
+    if (!bank.withdraw(player, session.wager, session.id)) {
+        reply_ephemeral(event, "You don't have enough coins to accept.");
+        return false;
+    }
+    session.escrow += session.wager;
+    session.accepted = true;
+    session.expires_at = std::chrono::steady_clock::now() + GAME_SESSION_TTL;
+
+    if (session.kind == GameKind::Dice) {
+        const int challenger_roll = roll_die() + roll_die();
+        const int opponent_roll = roll_die() + roll_die();
+        std::string result = mention(session.challenger) + " rolled " + std::to_string(challenger_roll) + ", " +
+            mention(session.opponent) + " rolled " + std::to_string(opponent_roll) + ". ";
+
+        if (challenger_roll == opponent_roll) {
+            bank.deposit(session.challenger, session.wager);
+            bank.deposit(session.opponent, session.wager);
+            result += "It's a tie, both wagers were returned.";
+        } else {
+            const uint64_t winner = challenger_roll > opponent_roll ? session.challenger : session.opponent;
+            bank.deposit(winner, session.escrow);
+            result += mention(winner) + " wins " + std::to_string(session.escrow) + " coins!";
+        }
+        session.escrow = 0;
+        finish_game(event, result);
+        return true;
+    }
+
+    // Rock, Paper, Scissors: both players now pick on the same message
+    dpp::message msg(mention(session.challenger) + " vs " + mention(session.opponent) + " for " + std::to_string(session.escrow) + " coins, both pick your move!");
+    msg.add_component(rps_buttons(session.id));
+    event.reply(dpp::ir_update_message, msg);
+    return false;
+}
+
+// Handles a move button. Returns true when the session is done.
+bool bot_command_handler::play_move(const dpp::button_click_t& event, GameSession& session, const std::string& action, uint64_t player) {
+    const bool is_challenger = player == session.challenger;
+    const bool is_opponent = session.accepted && player == session.opponent;
+    if (!is_challenger && !is_opponent) {
+        reply_ephemeral(event, "This game isn't yours.");
+        return false;
+    }
+
+    switch (session.kind) {
+    case GameKind::RockPaperScissors: {
+        int move = -1;
+        for (size_t i = 0; i < RPS_MOVES.size(); ++i) {
+            if (action == RPS_MOVES[i]) {
+                move = static_cast<int>(i);
+            }
+        }
+        if (move < 0) {
+            reply_ephemeral(event, "That isn't a move in this game.");
+            return false;
+        }
+
+        (is_challenger ? session.challenger_move : session.opponent_move) = move;
+        if (session.opponent == 0) {
+            session.opponent_move = std::uniform_int_distribution<int>(0, 2)(thread_rng());
+        }
+        if (session.challenger_move < 0 || session.opponent_move < 0) {
+            reply_ephemeral(event, std::string("You picked ") + RPS_MOVES[move] + ", waiting for your opponent.");
+            return false;
+        }
+
+        const std::string opponent_name = session.opponent == 0 ? "The house" : mention(session.opponent);
+        std::string result = mention(session.challenger) + " picked " + RPS_MOVES[session.challenger_move] + ", " +
+            opponent_name + " picked " + RPS_MOVES[session.opponent_move] + ". ";
+
+        // (a - b) mod 3 == 1 means a beats b
+        const int outcome = (session.challenger_move - session.opponent_move + 3) % 3;
+        if (outcome == 0) {
+            bank.deposit(session.challenger, session.wager);
+            if (session.accepted) {
+                bank.deposit(session.opponent, session.wager);
+            }
+            result += "It's a tie, wagers were returned.";
+        } else if (outcome == 1) {
+            // Against the house the challenger is paid the house's matching stake as well
+            bank.deposit(session.challenger, session.accepted ? session.escrow : session.wager * 2);
+            result += mention(session.challenger) + " wins!";
+        } else {
+            if (session.accepted) {
+                bank.deposit(session.opponent, session.escrow);
+            }
+            result += opponent_name + " wins!";
+        }
+        session.escrow = 0;
+        finish_game(event, result);
+        return true;
+    }
+
+    case GameKind::Roulette: {
+        static constexpr std::array<int, 18> RED_NUMBERS = { 1, 3, 5, 7, 9, 12, 14, 16, 18, 19, 21, 23, 25, 27, 30, 32, 34, 36 };
+        if (action != "red" && action != "black" && action != "green") {
+            reply_ephemeral(event, "That isn't a bet in this game.");
+            return false;
+        }
+
+        const int pocket = std::uniform_int_distribution<int>(0, 36)(thread_rng());
+        const bool red = std::find(RED_NUMBERS.begin(), RED_NUMBERS.end(), pocket) != RED_NUMBERS.end();
+        const std::string color = pocket == 0 ? "green" : (red ? "red" : "black");
+
+        std::string result = "The ball landed on " + std::to_string(pocket) + " " + color + ". ";
+        if (action == color) {
+            const int64_t payout = session.wager * (color == "green" ? 36 : 2);
+            bank.deposit(session.challenger, payout);
+            result += mention(session.challenger) + " wins " + std::to_string(payout - session.wager) + " coins!";
+        } else {
+            result += mention(session.challenger) + " loses " + std::to_string(session.wager) + " coins.";
+        }
+        session.escrow = 0;
+        finish_game(event, result);
+        return true;
+    }
+
+    case GameKind::Guess: {
+        int guess = 0;
+        try {
+            guess = std::stoi(action);
+        } catch (const std::exception&) {
+            reply_ephemeral(event, "That isn't a guess in this game.");
+            return false;
+        }
+
+        const int number = std::uniform_int_distribution<int>(1, 5)(thread_rng());
+        std::string result = mention(session.challenger) + " guessed " + std::to_string(guess) + ", the number was " + std::to_string(number) + ". ";
+        if (guess == number) {
+            bank.deposit(session.challenger, session.wager * 4);
+            result += "You win " + std::to_string(session.wager * 3) + " coins!";
+        } else {
+            result += "You lose " + std::to_string(session.wager) + " coins.";
+        }
+        session.escrow = 0;
+        finish_game(event, result);
+        return true;
+    }
+
+    case GameKind::Dice:
+        // Dice challenges resolve on accept, there are no move buttons
+        break;
+    }
+    reply_ephemeral(event, "That isn't a move in this game.");
+    return false;
 }
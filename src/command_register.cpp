@@ -1,57 +1,225 @@
 #include "include/command_register.h"
 #include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
+#include <unordered_map>
 
-void register_global_commands(dpp::cluster& bot) {
-    bot.on_ready([&bot](const dpp::ready_t& event) {
-        if (dpp::run_once<struct register_bot_commands>()) {
-            std::vector<dpp::slashcommand> commands = {
-                dpp::slashcommand("balance", "Check the balance of a user", bot.me.id)
-                    .add_option(dpp::command_option(dpp::co_user, "user", "The user to check balance for", false)),
+// Where the schema hash of the last successful registration is kept
+constexpr const char* COMMAND_HASH_FILE = "config/commands.hash";
+
+static std::vector<dpp::slashcommand> build_global_commands(dpp::cluster& bot) {
+    return {
+        dpp::slashcommand("balance", "Check the balance of a user", bot.me.id)
+            .add_option(dpp::command_option(dpp::co_user, "user", "The user to check balance for", false)),
 
-                dpp::slashcommand("coins", "Check the balance of a user (alias of /balance)", bot.me.id)
-                    .add_option(dpp::command_option(dpp::co_user, "user", "The user to check balance for", false)),
+        dpp::slashcommand("coins", "Check the balance of a user (alias of /balance)", bot.me.id)
+            .add_option(dpp::command_option(dpp::co_user, "user", "The user to check balance for", false)),
 
-                dpp::slashcommand("richest", "See the richest user", bot.me.id),
+        dpp::slashcommand("richest", "See the richest user", bot.me.id),
 
-                dpp::slashcommand("top", "See the top users (alias of /richest)", bot.me.id),
+        dpp::slashcommand("top", "See the top users (alias of /richest)", bot.me.id),
 
-                dpp::slashcommand("dice", "Roll a dice with a specified amount or challenge a user", bot.me.id)
-                    .add_option(dpp::command_option(dpp::co_integer, "amount", "Amount to roll the dice with", true))
-                    .add_option(dpp::command_option(dpp::co_user, "user", "The user to challenge", false)),
+        dpp::slashcommand("dice", "Roll a dice with a specified amount or challenge a user", bot.me.id)
+            .add_option(dpp::command_option(dpp::co_integer, "amount", "Amount to roll the dice with", true))
+            .add_option(dpp::command_option(dpp::co_user, "user", "The user to challenge", false)),
 
-                dpp::slashcommand("work", "Do a job", bot.me.id)
-                    .add_option(dpp::command_option(dpp::co_string, "job", "Type of job to perform", true)
-                        .add_choice(dpp::command_option_choice("Construction Work", "construction_work"))
-                        .add_choice(dpp::command_option_choice("Office Job", "office_job"))
-                        .add_choice(dpp::command_option_choice("Startup Founder", "startup_founder"))),
+        dpp::slashcommand("work", "Do a job", bot.me.id)
+            .add_option(dpp::command_option(dpp::co_string, "job", "Type of job to perform", true)
+                .add_choice(dpp::command_option_choice("Construction Work", "construction_work"))
+                .add_choice(dpp::command_option_choice("Office Job", "office_job"))
+                .add_choice(dpp::command_option_choice("Startup Founder", "startup_founder"))),
 
-                dpp::slashcommand("daily", "Claim your daily reward", bot.me.id),
+        dpp::slashcommand("daily", "Claim your daily reward", bot.me.id),
 
-                dpp::slashcommand("rps", "Play Rock, Paper, Scissors", bot.me.id)
-                    .add_option(dpp::command_option(dpp::co_integer, "amount", "The amount to wager", true))
-                    .add_option(dpp::command_option(dpp::co_user, "user", "The user to challenge", false)),
+        dpp::slashcommand("rps", "Play Rock, Paper, Scissors", bot.me.id)
+            .add_option(dpp::command_option(dpp::co_integer, "amount", "The amount to wager", true))
+            .add_option(dpp::command_option(dpp::co_user, "user", "The user to challenge", false)),
 
-                dpp::slashcommand("roulette", "Play roulette with a specified amount", bot.me.id)
-                    .add_option(dpp::command_option(dpp::co_integer, "amount", "Amount to wager", true)),
+        dpp::slashcommand("roulette", "Play roulette with a specified amount", bot.me.id)
+            .add_option(dpp::command_option(dpp::co_integer, "amount", "Amount to wager", true)),
 
-                dpp::slashcommand("guess", "Play a guessing game", bot.me.id)
-                    .add_option(dpp::command_option(dpp::co_integer, "amount", "Amount to wager", true)),
+        dpp::slashcommand("guess", "Play a guessing game", bot.me.id)
+            .add_option(dpp::command_option(dpp::co_integer, "amount", "Amount to wager", true)),
 
-                dpp::slashcommand("market", "Access the market", bot.me.id),
+        dpp::slashcommand("market", "Access the market", bot.me.id),
 
-                dpp::slashcommand("shop", "Access the shop (alias of /market)", bot.me.id),
+        dpp::slashcommand("shop", "Access the shop (alias of /market)", bot.me.id),
 
-                dpp::slashcommand("buy", "Buy an item from the shop", bot.me.id)
-                    .add_option(dpp::command_option(dpp::co_integer, "item_number", "The item number to buy", true))
-            };
+        dpp::slashcommand("buy", "Buy an item from the shop", bot.me.id)
+            .add_option(dpp::command_option(dpp::co_integer, "item_number", "The item number to buy", true)),
 
-            bot.global_bulk_command_create(commands, [](const dpp::confirmation_callback_t& event) {
+        dpp::slashcommand("assignments", "List Canvas assignments that are still awaiting grades", bot.me.id),
+
+        dpp::slashcommand("grades", "List Canvas assignments whose grades have been released", bot.me.id),
+
+        dpp::slashcommand("search", "Search past announcements", bot.me.id)
+            .add_option(dpp::command_option(dpp::co_string, "query", "Words to look for", true))
+    };
+}
+
+// Serialize only the fields we set ourselves, so a command built locally and the
+// same command returned by Discord (with ids, versions, etc.) produce the same text
+static void append_option(std::ostringstream& out, const dpp::command_option& option) {
+    out << "{" << static_cast<int>(option.type) << "|" << option.name << "|" << option.description << "|" << option.required;
+    for (const auto& choice : option.choices) {
+        out << "[" << choice.name << "=";
+        std::visit([&out](const auto& value) {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<T, std::monostate>) {
+                out << "null";
+            } else if constexpr (std::is_same_v<T, dpp::snowflake>) {
+                out << static_cast<uint64_t>(value);
+            } else {
+                out << value;
+            }
+        }, choice.value);
+        out << "]";
+    }
+    for (const auto& sub_option : option.options) {
+        append_option(out, sub_option);
+    }
+    out << "}";
+}
+
+static uint64_t hash_command(const dpp::slashcommand& command) {
+    std::ostringstream out;
+    out << command.name << "|" << command.description;
+    for (const auto& option : command.options) {
+        append_option(out, option);
+    }
+
+    // FNV-1a, stable across builds and platforms unlike std::hash
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : out.str()) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t hash_commands(const std::vector<dpp::slashcommand>& commands) {
+    // Commands are kept in declaration order, so combining in order is stable
+    uint64_t hash = 14695981039346656037ULL;
+    for (const auto& command : commands) {
+        hash ^= hash_command(command);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string format_hash(uint64_t hash) {
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return out.str();
+}
+
+static std::string read_stored_hash() {
+    std::ifstream file(COMMAND_HASH_FILE);
+    std::string hash;
+    if (file.is_open()) {
+        file >> hash;
+    }
+    return hash;
+}
+
+static void write_stored_hash(const std::string& hash) {
+    std::ofstream file(COMMAND_HASH_FILE, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Could not write command hash file: " << COMMAND_HASH_FILE << "\n";
+        return;
+    }
+    file << hash << "\n";
+}
+
+void register_global_commands(dpp::cluster& bot) {
+    bot.on_ready([&bot](const dpp::ready_t&) {
+        if (dpp::run_once<struct register_bot_commands>()) {
+            std::vector<dpp::slashcommand> commands = build_global_commands(bot);
+            std::string hash = format_hash(hash_commands(commands));
+
+            bot.global_bulk_command_create(commands, [hash](const dpp::confirmation_callback_t& event) {
                 if (event.is_error()) {
                     std::cerr << "Error registering commands: " << event.get_error().message << "\n";
                 } else {
+                    write_stored_hash(hash);
                     std::cout << "Commands registered successfully!\n";
                 }
             });
         }
     });
 }
+
+void sync_global_commands(dpp::cluster& bot) {
+    bot.on_ready([&bot](const dpp::ready_t&) {
+        if (dpp::run_once<struct sync_bot_commands>()) {
+            std::vector<dpp::slashcommand> commands = build_global_commands(bot);
+            std::string hash = format_hash(hash_commands(commands));
+
+            if (read_stored_hash() == hash) {
+                std::cout << "Command schema unchanged (" << hash << "), skipping registration.\n";
+                return;
+            }
+
+            // Local hash is missing or stale, compare against what Discord actually has
+            bot.global_commands_get([&bot, commands, hash](const dpp::confirmation_callback_t& event) {
+                if (event.is_error()) {
+                    std::cerr << "Error fetching registered commands: " << event.get_error().message << "\n";
+                    return;
+                }
+
+                std::unordered_map<std::string, dpp::slashcommand> remote;
+                for (const auto& [id, command] : event.get<dpp::slashcommand_map>()) {
+                    remote[command.name] = command;
+                }
+
+                std::vector<dpp::slashcommand> changed;
+                size_t unchanged = 0;
+                for (const auto& command : commands) {
+                    auto it = remote.find(command.name);
+                    if (it == remote.end()) {
+                        changed.push_back(command);
+                    } else if (hash_command(it->second) != hash_command(command)) {
+                        dpp::slashcommand edited = command;
+                        edited.id = it->second.id;
+                        changed.push_back(edited);
+                    } else {
+                        ++unchanged;
+                    }
+                }
+
+                auto on_done = [hash](const dpp::confirmation_callback_t& event) {
+                    if (event.is_error()) {
+                        std::cerr << "Error registering commands: " << event.get_error().message << "\n";
+                    } else {
+                        write_stored_hash(hash);
+                        std::cout << "Commands registered successfully!\n";
+                    }
+                };
+
+                // Anything registered remotely that we no longer declare needs the bulk overwrite to remove it
+                bool has_stale = remote.size() > unchanged + std::count_if(changed.begin(), changed.end(),
+                    [](const dpp::slashcommand& command) { return !command.id.empty(); });
+
+                if (changed.empty() && !has_stale) {
+                    std::cout << "Registered commands already match the local schema.\n";
+                    write_stored_hash(hash);
+                } else if (changed.size() == 1 && !has_stale) {
+                    const dpp::slashcommand& command = changed.front();
+                    if (command.id.empty()) {
+                        std::cout << "Creating command /" << command.name << "\n";
+                        bot.global_command_create(command, on_done);
+                    } else {
+                        std::cout << "Updating command /" << command.name << "\n";
+                        bot.global_command_edit(command, on_done);
+                    }
+                } else {
+                    std::cout << "Command schema changed, overwriting all global commands.\n";
+                    bot.global_bulk_command_create(commands, on_done);
+                }
+            });
+        }
+    });
+}
@@ -45,40 +45,49 @@ void Config::reload(const std::string& filename) {
 	canvas_updates_.check_interval = canvas["check_interval"].asInt();
 	canvas_updates_.discord_channel_id = canvas["discord_channel_id"].asString();
 	canvas_updates_.ping_role_id = canvas["ping_role_id"].asString();
-}
+	canvas_updates_.fetch_mode = canvas.get("fetch_mode", "rest").asString();
 
-void Config::load(const std::string& filename) {
-	std::ifstream file(filename);
-	if (!file.is_open()) {
-		throw std::runtime_error("Could not open config file: " + filename);
-	}
+	const auto& live_events = canvas["live_events"];
+	canvas_updates_.live_events_port = live_events.get("port", 0).asInt();
+	canvas_updates_.reconcile_interval = live_events.get("reconcile_interval", 1800).asInt();
 
-	Json::Value root;
-	Json::CharReaderBuilder readerBuilder;
-	std::string errs;
+	// Load HTTP transport settings
+	const auto& transport = root["transport"];
+	transport_.http2 = transport.get("http2", true).asBool();
+	transport_.compression = transport.get("compression", true).asBool();
+	transport_.max_host_connections = transport.get("max_host_connections", 2).asInt();
 
-	if (!Json::parseFromStream(readerBuilder, file, &root, &errs)) {
-		throw std::runtime_error("Error parsing config file: " + errs);
-	}
+	// Load sharding settings
+	const auto& sharding = root["sharding"];
+	sharding_.enabled = sharding.get("enabled", false).asBool();
+	sharding_.instance_id = sharding.get("instance_id", "").asString();
+	sharding_.state_dir = sharding.get("state_dir", "config/shards").asString();
+	sharding_.lease_seconds = sharding.get("lease_seconds", 30).asInt();
+	sharding_.virtual_nodes = sharding.get("virtual_nodes", 64).asInt();
+	sharding_.primary = sharding.get("primary", true).asBool();
 
-	// Load RSS feeds
-	const auto& rss_feeds = root["rss_feeds"];
-	for (const auto& feed : rss_feeds) {
-		RSSFeedConfig feedConfig;
-		feedConfig.feed_url = feed["feed_url"].asString();
-		feedConfig.check_interval = feed["check_interval"].asInt();
-		feedConfig.discord_channel_id = feed["discord_channel_id"].asString();
-		feedConfig.ping_role_id = feed["ping_role_id"].asString();
-		rss_feeds_.push_back(feedConfig);
+	// Load Discord gateway settings
+	const auto& discord = root["discord"];
+	discord_.intents.reset();
+	if (discord["intents"].isArray()) {
+		discord_.intents.emplace();
+		for (const auto& intent : discord["intents"]) {
+			discord_.intents->push_back(intent.asString());
+		}
 	}
+	const auto& cache = discord["cache"];
+	discord_.user_cache = cache.get("users", "aggressive").asString();
+	discord_.emoji_cache = cache.get("emojis", "aggressive").asString();
+	discord_.role_cache = cache.get("roles", "aggressive").asString();
+	discord_.channel_cache = cache.get("channels", "aggressive").asString();
+	discord_.guild_cache = cache.get("guilds", "aggressive").asString();
+	discord_.shard_count = discord.get("shard_count", 0).asInt();
+	discord_.cluster_id = discord.get("cluster_id", 0).asInt();
+	discord_.max_clusters = discord.get("max_clusters", 1).asInt();
+}
 
-	// Load Canvas updates
-	const auto& canvas = root["canvas_updates"];
-	canvas_updates_.api_url = canvas["api_url"].asString();
-	canvas_updates_.course_id = canvas["course_id"].asString();
-	canvas_updates_.check_interval = canvas["check_interval"].asInt();
-	canvas_updates_.discord_channel_id = canvas["discord_channel_id"].asString();
-	canvas_updates_.ping_role_id = canvas["ping_role_id"].asString();
+void Config::load(const std::string& filename) {
+	reload(filename);
 }
 
 const std::vector<RSSFeedConfig>& Config::getRSSFeeds() const noexcept {
@@ -87,4 +96,16 @@ const std::vector<RSSFeedConfig>& Config::getRSSFeeds() const noexcept {
 
 CanvasConfig& Config::getCanvasConfig() noexcept {
 	return canvas_updates_;
-}
\ No newline at end of file
+}
+
+const TransportConfig& Config::getTransportConfig() const noexcept {
+	return transport_;
+}
+
+const ShardingConfig& Config::getShardingConfig() const noexcept {
+	return sharding_;
+}
+
+const DiscordConfig& Config::getDiscordConfig() const noexcept {
+	return discord_;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -16,6 +17,37 @@ struct CanvasConfig {
 	int check_interval;
 	std::string discord_channel_id;
 	std::string ping_role_id;
+	std::string fetch_mode; // "rest" (default) or "graphql"
+	int live_events_port;   // 0 disables the live events listener
+	int reconcile_interval; // Poll interval while live events are enabled
+};
+
+struct TransportConfig {
+	bool http2 = true;            // Multiplex requests to a host over one HTTP/2 connection
+	bool compression = true;      // Advertise every encoding libcurl supports (gzip, br, ...)
+	int max_host_connections = 2; // 0 means unlimited
+};
+
+struct ShardingConfig {
+	bool enabled = false;
+	std::string instance_id;                 // Defaults to <hostname>-<pid>
+	std::string state_dir = "config/shards"; // Shared by every instance
+	int lease_seconds = 30;                  // How long a dead instance keeps its feeds and courses
+	int virtual_nodes = 64;                  // Ring positions per instance
+	bool primary = true;                     // Owns interactions, the bank, cooldowns and the archive, one per state_dir
+};
+
+// Gateway settings passed to dpp::cluster, the defaults match D++'s own
+struct DiscordConfig {
+	std::optional<std::vector<std::string>> intents; // Intent names, unset keeps D++'s default intents
+	std::string user_cache = "aggressive";            // "aggressive", "lazy" or "none" for each cache
+	std::string emoji_cache = "aggressive";
+	std::string role_cache = "aggressive";
+	std::string channel_cache = "aggressive";
+	std::string guild_cache = "aggressive";
+	int shard_count = 0; // 0 uses the count Discord recommends
+	int cluster_id = 0;  // This process runs the shards where shard_id % max_clusters == cluster_id
+	int max_clusters = 1;
 };
 
 class Config {
@@ -26,10 +58,16 @@ public:
 	void reload(const std::string& filename);
 	const std::vector<RSSFeedConfig>& getRSSFeeds() const noexcept;
 	CanvasConfig& getCanvasConfig() noexcept;
+	const TransportConfig& getTransportConfig() const noexcept;
+	const ShardingConfig& getShardingConfig() const noexcept;
+	const DiscordConfig& getDiscordConfig() const noexcept;
 
 private:
 	Config() = default;
 
 	std::vector<RSSFeedConfig> rss_feeds_;
 	CanvasConfig canvas_updates_;
+	TransportConfig transport_;
+	ShardingConfig sharding_;
+	DiscordConfig discord_;
 };
\ No newline at end of file
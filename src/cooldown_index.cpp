@@ -0,0 +1,215 @@
+#include "include/cooldown_index.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// On disk every record is user (8 bytes), command (1 byte), expiry (4 bytes), host byte order
+constexpr size_t RECORD_SIZE = 13;
+
+CooldownIndex::CooldownIndex(const std::string& persist_path) : persist_path_(persist_path) {
+	load();
+	{
+		std::lock_guard<std::mutex> lock(persist_mutex_);
+		compact();
+	}
+	if (!persist_file_) {
+		persist_file_ = std::fopen(persist_path_.c_str(), "ab");
+	}
+	if (!persist_file_) {
+		std::cerr << "Could not open cooldown file: " << persist_path_ << ", cooldowns won't survive restarts\n";
+	}
+}
+
+CooldownIndex::~CooldownIndex() {
+	if (persist_file_) {
+		std::fclose(persist_file_);
+	}
+}
+
+bool CooldownIndex::tryAcquire(uint64_t user, CooldownCommand command, std::chrono::seconds cooldown, std::chrono::seconds& remaining) {
+	if (cooldown > MAX_COOLDOWN) {
+		cooldown = MAX_COOLDOWN;
+	}
+
+	const Key key{ user, command };
+	const uint32_t now = unixNow();
+	Shard& shard = shardFor(key);
+
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		sweep(shard, now);
+
+		auto it = shard.expiries.find(key);
+		if (it != shard.expiries.end() && it->second.expiry > now) {
+			remaining = std::chrono::seconds(it->second.expiry - now);
+			return false;
+		}
+		insert(shard, key, { now + static_cast<uint32_t>(cooldown.count()), cooldown >= PERSIST_THRESHOLD });
+	}
+
+	if (cooldown >= PERSIST_THRESHOLD) {
+		append(key, now + static_cast<uint32_t>(cooldown.count()));
+	}
+	remaining = std::chrono::seconds(0);
+	return true;
+}
+
+size_t CooldownIndex::size() {
+	size_t total = 0;
+	for (auto& shard : shards_) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		total += shard.expiries.size();
+	}
+	return total;
+}
+
+CooldownIndex::Shard& CooldownIndex::shardFor(const Key& key) {
+	return shards_[KeyHash{}(key) >> 58];
+}
+
+void CooldownIndex::insert(Shard& shard, const Key& key, Entry entry) {
+	shard.expiries[key] = entry;
+	// Rounded up so the bucket is only drained once every entry in it has expired
+	shard.buckets[((entry.expiry + BUCKET_SECONDS - 1) / BUCKET_SECONDS) % BUCKETS].push_back(key);
+}
+
+// Drains buckets whose whole minute has passed. A key can sit in several buckets if it was
+// re-acquired, it is only erased once its current expiry is in the past.
+void CooldownIndex::sweep(Shard& shard, uint32_t now) {
+	const uint32_t current_bucket = now / BUCKET_SECONDS;
+	if (shard.swept_bucket == 0) {
+		// First sweep, the ring only holds entries restored by load() which are all still running
+		shard.swept_bucket = current_bucket;
+		return;
+	}
+	if (current_bucket - shard.swept_bucket >= BUCKETS) {
+		// Idle for longer than the ring spans, everything in it has expired, visit each slot once
+		shard.swept_bucket = current_bucket - static_cast<uint32_t>(BUCKETS) + 1;
+	}
+
+	for (; shard.swept_bucket <= current_bucket; ++shard.swept_bucket) {
+		auto& bucket = shard.buckets[shard.swept_bucket % BUCKETS];
+		for (const auto& key : bucket) {
+			auto it = shard.expiries.find(key);
+			if (it != shard.expiries.end() && it->second.expiry <= now) {
+				shard.expiries.erase(it);
+			}
+		}
+		bucket.clear();
+	}
+	// The current bucket may still receive entries, revisit it next time
+	shard.swept_bucket = current_bucket;
+}
+
+static void encodeRecord(unsigned char* record, uint64_t user, uint8_t command, uint32_t expiry) {
+	std::memcpy(record, &user, sizeof(user));
+	record[8] = command;
+	std::memcpy(record + 9, &expiry, sizeof(expiry));
+}
+
+// Replays the log, keeping only cooldowns still running. The constructor then compacts it.
+void CooldownIndex::load() {
+	std::FILE* file = std::fopen(persist_path_.c_str(), "rb");
+	if (!file) {
+		return;
+	}
+
+	const uint32_t now = unixNow();
+	unsigned char record[RECORD_SIZE];
+	size_t loaded = 0;
+	while (std::fread(record, 1, RECORD_SIZE, file) == RECORD_SIZE) {
+		Key key{};
+		uint32_t expiry = 0;
+		std::memcpy(&key.user, record, sizeof(key.user));
+		key.command = static_cast<CooldownCommand>(record[8]);
+		std::memcpy(&expiry, record + 9, sizeof(expiry));
+		if (expiry <= now) {
+			continue;
+		}
+
+		Shard& shard = shardFor(key);
+		auto it = shard.expiries.find(key);
+		if (it == shard.expiries.end()) {
+			++loaded;
+		}
+		if (it == shard.expiries.end() || it->second.expiry < expiry) {
+			insert(shard, key, { expiry, true });
+		}
+	}
+	std::fclose(file);
+
+	std::cout << "Restored " << loaded << " cooldowns from " << persist_path_ << "\n";
+}
+
+void CooldownIndex::append(const Key& key, uint32_t expiry) {
+	unsigned char record[RECORD_SIZE];
+	encodeRecord(record, key.user, static_cast<uint8_t>(key.command), expiry);
+
+	std::lock_guard<std::mutex> lock(persist_mutex_);
+	if (!persist_file_) {
+		return;
+	}
+	if (std::fwrite(record, 1, RECORD_SIZE, persist_file_) != RECORD_SIZE || std::fflush(persist_file_) != 0) {
+		std::cerr << "Could not append to cooldown file: " << persist_path_ << "\n";
+		return;
+	}
+
+	// Every re-acquire leaves a dead record behind, rewrite once they outnumber the live ones
+	if (++log_records_ >= std::max(MIN_COMPACT_RECORDS, live_records_ * 2) && !compact()) {
+		live_records_ = log_records_; // Back off instead of retrying on every append
+	}
+}
+
+// Writes the running persisted cooldowns to a temporary file and renames it over the log.
+// The old log is kept unless every write, the flush and the close succeeded.
+bool CooldownIndex::compact() {
+	const uint32_t now = unixNow();
+	std::vector<unsigned char> records;
+	for (auto& shard : shards_) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		for (const auto& [key, entry] : shard.expiries) {
+			if (entry.persisted && entry.expiry > now) {
+				records.resize(records.size() + RECORD_SIZE);
+				encodeRecord(records.data() + records.size() - RECORD_SIZE, key.user, static_cast<uint8_t>(key.command), entry.expiry);
+			}
+		}
+	}
+
+	const std::string compacted_path = persist_path_ + ".tmp";
+	std::FILE* compacted = std::fopen(compacted_path.c_str(), "wb");
+	if (!compacted) {
+		std::cerr << "Could not compact cooldown file: " << persist_path_ << "\n";
+		return false;
+	}
+	bool written = records.empty() || std::fwrite(records.data(), 1, records.size(), compacted) == records.size();
+	written = std::fflush(compacted) == 0 && written;
+	written = fsync(fileno(compacted)) == 0 && written;
+	written = std::fclose(compacted) == 0 && written;
+	if (!written) {
+		std::cerr << "Could not compact cooldown file: " << persist_path_ << ", keeping the old one\n";
+		std::remove(compacted_path.c_str());
+		return false;
+	}
+
+	if (persist_file_) {
+		std::fclose(persist_file_);
+		persist_file_ = nullptr;
+	}
+	const bool renamed = std::rename(compacted_path.c_str(), persist_path_.c_str()) == 0;
+	if (!renamed) {
+		std::remove(compacted_path.c_str());
+	}
+	persist_file_ = std::fopen(persist_path_.c_str(), "ab");
+
+	if (renamed) {
+		log_records_ = records.size() / RECORD_SIZE;
+		live_records_ = log_records_;
+	}
+	return renamed;
+}
+
+uint32_t CooldownIndex::unixNow() {
+	return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count());
+}
@@ -0,0 +1,103 @@
+#include "include/game_session.h"
+#include <thread>
+#include <vector>
+
+std::mt19937_64& thread_rng() {
+	thread_local std::mt19937_64 rng(std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id()));
+	return rng;
+}
+
+GameSessionTable::GameSessionTable(Bank& bank)
+	: bank_(bank), start_time_(std::chrono::steady_clock::now()) {}
+
+void GameSessionTable::start() {
+	std::thread([this]() {
+		uint64_t tick = 0;
+		while (true) {
+			++tick;
+			std::this_thread::sleep_until(start_time_ + std::chrono::seconds(tick));
+
+			std::vector<uint64_t> due;
+			{
+				std::lock_guard<std::mutex> lock(expiry_mutex_);
+				expiry_.advance(tick, [&due](uint64_t&& id) {
+					due.push_back(id);
+					});
+			}
+			for (uint64_t id : due) {
+				expire(id);
+			}
+		}
+		}).detach();
+}
+
+void GameSessionTable::open(GameSession session, std::chrono::seconds ttl) {
+	session.expires_at = std::chrono::steady_clock::now() + ttl;
+	const uint64_t id = session.id;
+	const auto expires_at = session.expires_at;
+
+	Shard& shard = shardFor(id);
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		if (!shard.sessions.emplace(id, std::move(session)).second) {
+			return;
+		}
+	}
+	++size_;
+	scheduleExpiry(id, expires_at);
+}
+
+bool GameSessionTable::update(uint64_t id, const std::function<bool(GameSession&)>& fn) {
+	Shard& shard = shardFor(id);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+
+	auto it = shard.sessions.find(id);
+	if (it == shard.sessions.end()) {
+		return false;
+	}
+
+	if (fn(it->second)) {
+		shard.sessions.erase(it);
+		--size_;
+		bank_.settle(id);
+	}
+	return true;
+}
+
+GameSessionTable::Shard& GameSessionTable::shardFor(uint64_t id) {
+	// Snowflakes share their low bits with the worker/process ID, mix before picking a shard
+	return shards_[(id * 0x9E3779B97F4A7C15ULL >> 32) % SHARDS];
+}
+
+void GameSessionTable::scheduleExpiry(uint64_t id, std::chrono::steady_clock::time_point expires_at) {
+	std::lock_guard<std::mutex> lock(expiry_mutex_);
+	const auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(expires_at - start_time_).count();
+	const uint64_t due_tick = elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
+	expiry_.schedule(due_tick > expiry_.now() ? due_tick - expiry_.now() : 1, id);
+}
+
+void GameSessionTable::expire(uint64_t id) {
+	Shard& shard = shardFor(id);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+
+	auto it = shard.sessions.find(id);
+	if (it == shard.sessions.end()) {
+		return; // Already finished
+	}
+
+	GameSession& session = it->second;
+
+	// The TTL was extended after the timer was set, wait for the new deadline
+	if (session.expires_at > std::chrono::steady_clock::now()) {
+		scheduleExpiry(id, session.expires_at);
+		return;
+	}
+
+	bank_.deposit(session.challenger, session.wager);
+	if (session.accepted) {
+		bank_.deposit(session.opponent, session.wager);
+	}
+	bank_.settle(id);
+	shard.sessions.erase(it);
+	--size_;
+}
@@ -0,0 +1,127 @@
+#include "assignment_table.h"
+#include <chrono>
+#include <cstdio>
+
+constexpr size_t MIN_TABLE_CAPACITY = 16;
+
+GradingType parseGradingType(std::string_view grading_type) {
+	if (grading_type == "points") return GradingType::Points;
+	if (grading_type == "percent") return GradingType::Percent;
+	if (grading_type == "letter_grade") return GradingType::LetterGrade;
+	if (grading_type == "gpa_scale") return GradingType::GpaScale;
+	if (grading_type == "pass_fail") return GradingType::PassFail;
+	if (grading_type == "not_graded") return GradingType::NotGraded;
+	return GradingType::Unknown;
+}
+
+int64_t parseCanvasTimestamp(std::string_view timestamp) {
+	if (timestamp.empty()) {
+		return 0;
+	}
+
+	const std::string value(timestamp);
+	int year, month, day, hour, minute, second;
+	int consumed = 0;
+	if (std::sscanf(value.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%n", &year, &month, &day, &hour, &minute, &second, &consumed) != 6) {
+		return 0;
+	}
+
+	// Skip fractional seconds, then apply a "+hh:mm"/"-hh:mm" offset if there is one ("Z" is UTC)
+	size_t pos = static_cast<size_t>(consumed);
+	if (pos < value.size() && value[pos] == '.') {
+		while (++pos < value.size() && value[pos] >= '0' && value[pos] <= '9') {}
+	}
+
+	int offset_seconds = 0;
+	if (pos < value.size() && (value[pos] == '+' || value[pos] == '-')) {
+		int offset_hour = 0, offset_minute = 0;
+		if (std::sscanf(value.c_str() + pos + 1, "%2d:%2d", &offset_hour, &offset_minute) >= 1) {
+			offset_seconds = (offset_hour * 3600 + offset_minute * 60) * (value[pos] == '-' ? -1 : 1);
+		}
+	}
+
+	const std::chrono::year_month_day date{ std::chrono::year{ year }, std::chrono::month{ static_cast<unsigned>(month) }, std::chrono::day{ static_cast<unsigned>(day) } };
+	if (!date.ok()) {
+		return 0;
+	}
+
+	const auto days = std::chrono::sys_days{ date }.time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::seconds>(days).count() + hour * 3600 + minute * 60 + second - offset_seconds;
+}
+
+std::string_view StringInterner::intern(std::string_view value) {
+	auto it = strings_.find(value);
+	if (it == strings_.end()) {
+		it = strings_.emplace(value).first;
+	}
+	return *it;
+}
+
+AssignmentInfo* AssignmentTable::find(int64_t id) {
+	return const_cast<AssignmentInfo*>(static_cast<const AssignmentTable*>(this)->find(id));
+}
+
+const AssignmentInfo* AssignmentTable::find(int64_t id) const {
+	if (id == 0 || slots_.empty()) {
+		return nullptr;
+	}
+
+	const size_t mask = slots_.size() - 1;
+	for (size_t i = slotFor(id); ; i = (i + 1) & mask) {
+		if (slots_[i].id == id) {
+			return &slots_[i];
+		}
+		if (slots_[i].id == 0) {
+			return nullptr;
+		}
+	}
+}
+
+std::pair<AssignmentInfo*, bool> AssignmentTable::insert(const AssignmentInfo& assignment) {
+	if (assignment.id == 0) {
+		return { nullptr, false };
+	}
+
+	// Keep the load factor at or below 0.7 so probe sequences stay short
+	if ((size_ + 1) * 10 > slots_.size() * 7) {
+		grow();
+	}
+
+	const size_t mask = slots_.size() - 1;
+	for (size_t i = slotFor(assignment.id); ; i = (i + 1) & mask) {
+		if (slots_[i].id == assignment.id) {
+			return { &slots_[i], false };
+		}
+		if (slots_[i].id == 0) {
+			slots_[i] = assignment;
+			++size_;
+			return { &slots_[i], true };
+		}
+	}
+}
+
+size_t AssignmentTable::countUngraded() const {
+	size_t count = 0;
+	for (const auto& slot : slots_) {
+		if (slot.id != 0 && !slot.graded) {
+			++count;
+		}
+	}
+	return count;
+}
+
+size_t AssignmentTable::slotFor(int64_t id) const {
+	// Fibonacci hashing, Canvas IDs are sequential so the low bits alone cluster badly
+	return static_cast<size_t>((static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ULL) >> 32) & (slots_.size() - 1);
+}
+
+void AssignmentTable::grow() {
+	std::vector<AssignmentInfo> old_slots = std::move(slots_);
+	slots_.assign(old_slots.empty() ? MIN_TABLE_CAPACITY : old_slots.size() * 2, AssignmentInfo{});
+	size_ = 0;
+	for (const auto& slot : old_slots) {
+		if (slot.id != 0) {
+			insert(slot);
+		}
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+enum class GradingType : uint8_t {
+	Unknown,
+	Points,
+	Percent,
+	LetterGrade,
+	GpaScale,
+	PassFail,
+	NotGraded
+};
+
+GradingType parseGradingType(std::string_view grading_type);
+
+// Canvas ISO 8601 timestamp ("2024-02-10T18:22:33Z") to Unix seconds, 0 if empty or malformed
+int64_t parseCanvasTimestamp(std::string_view timestamp);
+
+struct AssignmentInfo {
+	int64_t id = 0;             // Canvas assignment ID, 0 is never a valid ID
+	std::string_view name;      // Interned, see StringInterner
+	GradingType grading_type = GradingType::Unknown;
+	bool graded = false;
+	int64_t graded_at = 0;      // Unix seconds, 0 while ungraded
+};
+
+// Keeps one copy of every distinct string, the returned views stay valid for the interner's lifetime
+class StringInterner {
+public:
+	std::string_view intern(std::string_view value);
+	size_t size() const noexcept { return strings_.size(); }
+
+private:
+	struct Hash {
+		using is_transparent = void;
+		size_t operator()(std::string_view value) const noexcept { return std::hash<std::string_view>{}(value); }
+	};
+
+	std::unordered_set<std::string, Hash, std::equal_to<>> strings_;
+};
+
+// Open addressing (linear probing) map from assignment ID to AssignmentInfo. Assignments are
+// never removed, graded ones just have their flag set, so no tombstones are needed.
+class AssignmentTable {
+public:
+	class iterator {
+	public:
+		iterator(AssignmentInfo* slot, AssignmentInfo* end) : slot_(slot), end_(end) { skipEmpty(); }
+		AssignmentInfo& operator*() const { return *slot_; }
+		AssignmentInfo* operator->() const { return slot_; }
+		iterator& operator++() { ++slot_; skipEmpty(); return *this; }
+		bool operator==(const iterator& other) const { return slot_ == other.slot_; }
+
+	private:
+		AssignmentInfo* slot_;
+		AssignmentInfo* end_;
+
+		void skipEmpty() { while (slot_ != end_ && slot_->id == 0) ++slot_; }
+	};
+
+	AssignmentInfo* find(int64_t id);
+	const AssignmentInfo* find(int64_t id) const;
+
+	// Returns the stored entry and whether it was newly inserted
+	std::pair<AssignmentInfo*, bool> insert(const AssignmentInfo& assignment);
+
+	size_t size() const noexcept { return size_; }
+	size_t countUngraded() const;
+
+	iterator begin() { return iterator(slots_.data(), slots_.data() + slots_.size()); }
+	iterator end() { return iterator(slots_.data() + slots_.size(), slots_.data() + slots_.size()); }
+
+private:
+	std::vector<AssignmentInfo> slots_;
+	size_t size_ = 0;
+
+	size_t slotFor(int64_t id) const;
+	void grow();
+};
@@ -1,26 +1,160 @@
 #include "canvas_handler.h"
-#include <curl/curl.h>
 #include <json/json.h>
 #include <thread>
 #include <stdexcept>
 #include <sstream>
 #include <string>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
 
 constexpr int CURL_REQUEST_DELAY = 15;
+constexpr int GRAPHQL_PAGE_SIZE = 50;
+constexpr int ASSIGNMENTS_PER_PAGE = 20;
+// Upper bound on assignment pages requested at the same time
+constexpr size_t MAX_PAGES_IN_FLIGHT = 4;
+constexpr auto SNAPSHOT_TTL = std::chrono::seconds(30);
+// How often the owner of the course picks up live events other instances received for it
+constexpr auto LIVE_EVENTS_IMPORT_INTERVAL = std::chrono::seconds(5);
+constexpr const char* LIVE_EVENT_EXTENSION = ".event";
+
+// Only the fields checkAssignments/checkSubmissions actually use
+static const char* COURSE_ASSIGNMENTS_QUERY = R"(
+query CourseAssignments($courseId: ID!, $after: String, $first: Int) {
+  course(id: $courseId) {
+    assignmentsConnection(first: $first, after: $after) {
+      nodes {
+        _id
+        name
+        gradingType
+        submissionsConnection(first: 1) {
+          nodes {
+            gradedAt
+          }
+        }
+      }
+      pageInfo {
+        hasNextPage
+        endCursor
+      }
+    }
+  }
+})";
+
+// REST returns numeric IDs, GraphQL and live events use strings, accept either. 0 if missing.
+static int64_t parseCanvasId(const Json::Value& id) {
+	if (id.isIntegral()) {
+		return id.asInt64();
+	}
 
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* s) {
-	size_t newLength = size * nmemb;
-	try {
-		s->append(static_cast<char*>(contents), newLength);
-		return newLength;
+	int64_t parsed = 0;
+	const std::string id_string = id.asString();
+	std::from_chars(id_string.data(), id_string.data() + id_string.size(), parsed);
+	return parsed;
+}
+
+// Parses straight from the buffer, without copying it into a stream first
+static bool parseJson(std::string_view text, Json::Value& root, std::string& errs) {
+	Json::CharReaderBuilder readerBuilder;
+	std::unique_ptr<Json::CharReader> reader(readerBuilder.newCharReader());
+	return reader->parse(text.data(), text.data() + text.size(), &root, &errs);
+}
+
+static std::string_view trimWhitespace(std::string_view text) {
+	const size_t begin = text.find_first_not_of(" \t");
+	if (begin == std::string_view::npos) {
+		return {};
 	}
-	catch (const std::bad_alloc& e) {
-		return 0;
+	return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+// Whether an entry's parameters (everything after the URL) include rel among its relation types
+static bool linkHasRel(std::string_view parameters, std::string_view rel) {
+	while (!parameters.empty()) {
+		const size_t separator = parameters.find(';');
+		const std::string_view parameter = trimWhitespace(parameters.substr(0, separator));
+		parameters = separator == std::string_view::npos ? std::string_view() : parameters.substr(separator + 1);
+
+		const size_t equals = parameter.find('=');
+		if (equals == std::string_view::npos) {
+			continue;
+		}
+		// Parameter names are case-insensitive
+		std::string name(trimWhitespace(parameter.substr(0, equals)));
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		if (name != "rel") {
+			continue;
+		}
+
+		std::string_view value = trimWhitespace(parameter.substr(equals + 1));
+		if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+			value = value.substr(1, value.size() - 2);
+		}
+		// rel may hold several space separated relation types, e.g. rel="last next"
+		while (!value.empty()) {
+			const size_t space = value.find(' ');
+			if (value.substr(0, space) == rel) {
+				return true;
+			}
+			value = space == std::string_view::npos ? std::string_view() : trimWhitespace(value.substr(space + 1));
+		}
+	}
+	return false;
+}
+
+// URL of the entry with the given rel in a Link header such as
+// <https://...&page=2>; rel="next", <https://...&page=9>; rel="last". Empty if there is none.
+static std::string linkWithRel(std::string_view links, std::string_view rel) {
+	size_t position = 0;
+	while (position < links.size()) {
+		// Entries are separated by commas, with optional whitespace around them (RFC 8288)
+		position = links.find_first_not_of(" \t,", position);
+		if (position == std::string_view::npos || links[position] != '<') {
+			break;
+		}
+		const size_t close = links.find('>', position);
+		if (close == std::string_view::npos) {
+			break;
+		}
+
+		// The URL may itself contain commas, so the entry only ends at the first one after '>'
+		size_t end = links.find(',', close);
+		if (end == std::string_view::npos) {
+			end = links.size();
+		}
+		if (linkHasRel(links.substr(close + 1, end - close - 1), rel)) {
+			return std::string(links.substr(position + 1, close - position - 1));
+		}
+		position = end;
+	}
+	return {};
+}
+
+// Page number of rel="last", 0 if it's missing or not a plain page number
+static int lastPageFromLinks(std::string_view links) {
+	const std::string last = linkWithRel(links, "last");
+	for (const char* parameter : { "?page=", "&page=" }) {
+		const size_t found = last.find(parameter);
+		if (found != std::string::npos) {
+			const char* begin = last.data() + found + std::strlen(parameter);
+			const char* end = last.data() + last.size();
+			int page = 0;
+			auto [next, error] = std::from_chars(begin, end, page);
+			return error == std::errc() && (next == end || *next == '&') ? page : 0;
+		}
 	}
+	return 0;
 }
 
-CanvasHandler::CanvasHandler(dpp::cluster& bot, CanvasConfig& config, const std::string& api_token)
-	: bot_(bot), config_(config), api_token_(api_token) {
+CanvasHandler::CanvasHandler(dpp::cluster& bot, HttpClient& http, ShardCoordinator& shards, CanvasConfig& config, const std::string& api_token)
+	: bot_(bot), http_(http), shards_(shards), config_(config), api_token_(api_token) {
+	snapshot_.store(std::make_shared<const AssignmentSnapshot>(AssignmentSnapshot{ {}, std::chrono::steady_clock::now() }));
 	log("CanvasHandler initialized with course_id: " + config_.course_id);
 }
 
@@ -28,18 +162,56 @@ void CanvasHandler::start() {
 	std::thread([this]() {
 		while (true) {
 			try {
-				log("Reloading config file");
-				Config::getInstance().reload("config/config.json");
-				log("Setting configuration for canvas handler");
-				config_ = Config::getInstance().getCanvasConfig();
-
-				log("Starting assignment check...");
-				checkAssignments();
-
-				log("Starting submission check...");
-				checkSubmissions();
-
-				std::this_thread::sleep_for(std::chrono::seconds(config_.check_interval));
+				{
+					std::lock_guard<std::mutex> lock(state_mutex_);
+					log("Reloading config file");
+					Config::getInstance().reload("config/config.json");
+					log("Setting configuration for canvas handler");
+					config_ = Config::getInstance().getCanvasConfig();
+				}
+
+				// In sharded mode the course may belong to another instance
+				const std::string shard_key = shardKey();
+				bool newly_acquired = false;
+				if (!shards_.acquire(shard_key, newly_acquired)) {
+					log("Course " + config_.course_id + " is polled by another instance");
+					if (shards_.primary()) {
+						// /assignments and /grades are answered here, follow the owner's state
+						std::lock_guard<std::mutex> lock(state_mutex_);
+						restoreState(shards_.loadCursor(shard_key));
+					}
+					std::this_thread::sleep_for(std::chrono::seconds(config_.check_interval));
+					continue;
+				}
+				if (newly_acquired) {
+					std::lock_guard<std::mutex> lock(state_mutex_);
+					restoreState(shards_.loadCursor(shard_key));
+				}
+
+				// Response bodies and fetched lists die with the cycle, only tracked state is copied out
+				PollArena arena;
+				if (config_.fetch_mode == "graphql") {
+					log("Starting GraphQL course check...");
+					checkCourseGraphQL(arena.resource());
+				}
+				else {
+					log("Starting assignment check...");
+					checkAssignments(arena.resource());
+
+					log("Starting submission check...");
+					checkSubmissions(arena.resource());
+				}
+				log("Poll cycle used " + std::to_string(arena.bytesAllocated() / 1024) + " KiB of arena memory");
+
+				// With live events enabled polling is only a safety net for missed events. Another
+				// instance's listener may receive events for this course, so they're imported meanwhile.
+				const auto next_poll = std::chrono::steady_clock::now() +
+					std::chrono::seconds(live_events_ ? config_.reconcile_interval : config_.check_interval);
+				while (shards_.enabled() && std::chrono::steady_clock::now() + LIVE_EVENTS_IMPORT_INTERVAL < next_poll) {
+					std::this_thread::sleep_for(LIVE_EVENTS_IMPORT_INTERVAL);
+					importLiveEvents();
+				}
+				std::this_thread::sleep_until(next_poll);
 			}
 			catch (const std::exception& e) {
 				log("Exception in main loop: " + std::string(e.what()));
@@ -48,12 +220,12 @@ void CanvasHandler::start() {
 		}).detach();
 }
 
-void CanvasHandler::checkAssignments() {
+void CanvasHandler::checkAssignments(std::pmr::memory_resource* arena) {
 	log("Fetching assignments...");
-	std::vector<AssignmentInfo> fetched_assignments;
+	std::pmr::vector<AssignmentInfo> fetched_assignments(arena);
 	try {
 		std::this_thread::sleep_for(std::chrono::seconds(CURL_REQUEST_DELAY)); // Using the constant delay
-		fetched_assignments = fetchAssignments();
+		fetched_assignments = fetchAssignments(arena);
 	}
 	catch (const std::exception& e) {
 		log("Exception in checkAssignments: " + std::string(e.what()));
@@ -61,226 +233,201 @@ void CanvasHandler::checkAssignments() {
 	}
 
 	log("Processing fetched assignments...");
+	std::lock_guard<std::mutex> lock(state_mutex_);
 	for (const auto& assignment : fetched_assignments) {
-		if (assignment.id.empty() || assignment.name.empty() || assignment.grading_type == "not_graded") {
+		if (assignment.id == 0 || assignment.name.empty() || assignment.grading_type == GradingType::NotGraded) {
 			log("Skipping assignment due to empty ID, name, or non-gradable type.");
 			continue;
 		}
 
 		// Check if the assignment already exists in the assignments_
-		if (assignments_.find(assignment.id) == assignments_.end()) {
-			// New assignment
-			std::string message_content = "<@&" + config_.ping_role_id + "> A new assignment \"" + assignment.name + "\" was added.";
-			dpp::message msg(config_.discord_channel_id, message_content);
-			msg.allowed_mentions.parse_roles = true;
-			bot_.message_create(msg);
-
-			log("New assignment: " + assignment.name);
-
-			// Add to assignments_ and ungraded_assignments_
-			assignments_[assignment.id] = assignment;
-			ungraded_assignments_[assignment.id] = assignment;
-
-			log("Assignment is added to ungraded: " + assignment.name);
+		auto [entry, inserted] = assignments_.insert(assignment);
+		if (inserted) {
+			// New assignment, tracked as ungraded until checkSubmissions sees a grade
+			entry->name = internName(assignment.name);
+			announceNewAssignment(assignment);
+			log("Assignment is added to ungraded: " + std::string(assignment.name));
 		}
 		else {
-			log("Assignment \"" + assignment.name + "\" already exists and won't be added again.");
+			log("Assignment \"" + std::string(assignment.name) + "\" already exists and won't be added again.");
 		}
 	}
+	commitState();
 
 	log("Current ungraded assignments:");
-	for (const auto& [id, assignment] : ungraded_assignments_) {
-		log(" - " + assignment.name);
+	for (const auto& assignment : assignments_) {
+		if (!assignment.graded) {
+			log(" - " + std::string(assignment.name));
+		}
 	}
 }
 
-std::vector<AssignmentInfo> CanvasHandler::fetchAssignments() {
-	CURL* curl;
-	CURLcode res;
-	std::string response_string;
-	std::vector<AssignmentInfo> all_assignments;
-	int page = 1;
-	bool has_more_pages = true;
-	const int per_page = 20;
-
-	while (has_more_pages) {
-		curl = curl_easy_init();
-		if (!curl) {
-			log("Failed to initialize curl.");
-			return {};
-		}
-
-		std::string url = config_.api_url + "courses/" + config_.course_id +
+// The first page's Link header names the last page, the remaining pages are then requested
+// concurrently (at most MAX_PAGES_IN_FLIGHT at a time) and appended in page order. Any failed
+// page throws, so a partial list is never mistaken for the whole course.
+std::pmr::vector<AssignmentInfo> CanvasHandler::fetchAssignments(std::pmr::memory_resource* arena) {
+	std::pmr::vector<AssignmentInfo> all_assignments(arena);
+	auto page_url = [this](int page) {
+		return config_.api_url + "courses/" + config_.course_id +
 			"/assignments?page=" + std::to_string(page) +
-			"&per_page=" + std::to_string(per_page);
-
-		log("Fetching URL: " + url);
-		curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
-
-		struct curl_slist* headers = nullptr;
-		std::string auth_header = "Authorization: Bearer " + api_token_;
-		headers = curl_slist_append(headers, auth_header.c_str());
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-		log("Performing curl request for page: " + std::to_string(page));
-		res = curl_easy_perform(curl);
+			"&per_page=" + std::to_string(ASSIGNMENTS_PER_PAGE);
+	};
+
+	log("Fetching URL: " + page_url(1));
+	HttpResponse first = http_.perform(canvasRequest(page_url(1)));
+	appendAssignmentsPage(first, 1, all_assignments, arena);
+
+	const std::string links = first.header("Link");
+	const int last_page = lastPageFromLinks(links);
+
+	if (last_page > 1) {
+		log("Fetching pages 2 to " + std::to_string(last_page) + " concurrently");
+
+		// Bodies are buffered by the transport rather than streamed into the arena, which is
+		// only touched by this thread while it parses pages that already arrived
+		std::deque<std::pair<int, std::future<HttpResponse>>> in_flight;
+		int next_page = 2;
+		while (next_page <= last_page || !in_flight.empty()) {
+			while (next_page <= last_page && in_flight.size() < MAX_PAGES_IN_FLIGHT) {
+				in_flight.emplace_back(next_page, http_.submit(canvasRequest(page_url(next_page))));
+				++next_page;
+			}
 
-		if (res != CURLE_OK) {
-			log("Failed to fetch assignments (page " + std::to_string(page) + "): " + std::string(curl_easy_strerror(res)));
-			curl_easy_cleanup(curl);
-			curl_slist_free_all(headers);
-			return all_assignments;
+			auto [page, response] = std::move(in_flight.front());
+			in_flight.pop_front();
+			appendAssignmentsPage(response.get(), page, all_assignments, arena);
+		}
+	}
+	else if (last_page == 0) {
+		// No usable rel="last" (e.g. bookmark pagination), follow rel="next" one page at a time
+		std::string next_url = linkWithRel(links, "next");
+		for (int page = 2; !next_url.empty(); ++page) {
+			log("Fetching URL: " + next_url);
+			HttpResponse response = http_.perform(canvasRequest(next_url));
+			appendAssignmentsPage(response, page, all_assignments, arena);
+			next_url = linkWithRel(response.header("Link"), "next");
 		}
+	}
 
-		curl_easy_cleanup(curl);
-		curl_slist_free_all(headers);
+	log("Fetched " + std::to_string(all_assignments.size()) + " gradable assignments");
+	return all_assignments;
+}
 
-		log("Response size for page " + std::to_string(page) + ": " + std::to_string(response_string.size()) + " bytes");
+void CanvasHandler::appendAssignmentsPage(const HttpResponse& response, int page, std::pmr::vector<AssignmentInfo>& assignments, std::pmr::memory_resource* arena) {
+	const std::string page_name = "page " + std::to_string(page);
+	if (!response.ok()) {
+		throw std::runtime_error("Failed to fetch assignments (" + page_name + "): " + response.error);
+	}
+	if (response.status != 200) {
+		throw std::runtime_error("Failed to fetch assignments (" + page_name + "): HTTP " + std::to_string(response.status));
+	}
 
-		Json::Value root;
-		Json::CharReaderBuilder readerBuilder;
-		std::string errs;
+	log("Response size for " + page_name + ": " + std::to_string(response.body.size()) + " bytes");
 
-		try {
-			log("Parsing JSON response for page " + std::to_string(page));
-			std::istringstream response_stream(response_string);
-			if (!Json::parseFromStream(readerBuilder, response_stream, &root, &errs)) {
-				throw std::runtime_error("Failed to parse assignments JSON: " + errs);
-			}
-		}
-		catch (const std::exception& e) {
-			log("Exception in JSON parsing (page " + std::to_string(page) + "): " + std::string(e.what()));
-			return all_assignments;
-		}
-
-		log("Parsed JSON successfully for page " + std::to_string(page));
-		for (const auto& assignment_json : root) {
-			AssignmentInfo assignment;
-			assignment.id = assignment_json["id"].asString();
-			assignment.name = assignment_json["name"].asString();
-			assignment.grading_type = assignment_json["grading_type"].asString();
-
-			// Only add gradable assignments
-			if (assignment.grading_type != "not_graded") {
-				assignment.graded = false;
-				assignment.graded_at.clear();
-				all_assignments.push_back(assignment);
-				log("Fetched gradable assignment: " + assignment.name);
-			}
-			else {
-				log("Skipping non-gradable assignment: " + assignment.name);
-			}
-		}
+	Json::Value root;
+	std::string errs;
+	if (!parseJson(response.body, root, errs) || !root.isArray()) {
+		throw std::runtime_error("Failed to parse assignments JSON (" + page_name + "): " + (errs.empty() ? "not an array" : errs));
+	}
+
+	for (const auto& assignment_json : root) {
+		AssignmentInfo assignment = parseAssignment(assignment_json["id"], assignment_json["name"], assignment_json["grading_type"], arena);
 
-		if (root.size() < per_page) {
-			has_more_pages = false;
+		// Only add gradable assignments
+		if (assignment.grading_type != GradingType::NotGraded) {
+			assignments.push_back(assignment);
+			log("Fetched gradable assignment: " + std::string(assignment.name));
 		}
 		else {
-			page++;
+			log("Skipping non-gradable assignment: " + std::string(assignment.name));
 		}
-
-		response_string.clear();
 	}
-
-	return all_assignments;
 }
 
-void CanvasHandler::checkSubmissions() {
+void CanvasHandler::checkSubmissions(std::pmr::memory_resource* arena) {
 	log("Starting submission check...");
 
-	log("Printing what is currently in ungraded_assignments_");
-	for (auto it = ungraded_assignments_.begin(); it != ungraded_assignments_.end(); ) {
-		log(it->second.name);
-		++it;
+	// Requests are slow and spaced out, work on a copy so live events aren't blocked meanwhile
+	std::pmr::vector<AssignmentInfo> ungraded(arena);
+	{
+		std::lock_guard<std::mutex> lock(state_mutex_);
+		for (const auto& assignment : assignments_) {
+			if (!assignment.graded) {
+				ungraded.push_back(assignment);
+			}
+		}
+	}
+
+	log("Printing what is currently ungraded in assignments_");
+	for (const auto& assignment : ungraded) {
+		log(std::string(assignment.name));
 	}
 	log("DONE.");
 
 	int ret = 0;
 
-	for (auto it = ungraded_assignments_.begin(); it != ungraded_assignments_.end(); ) {
-		if (it->first.empty() || it->second.name.empty()) {
+	for (const auto& assignment : ungraded) {
+		if (assignment.name.empty()) {
 			log("Skipping submission check due to empty assignment ID or name.");
-			++it;
 			continue;
 		}
 
 		ret = 0;
+		int64_t graded_at = 0;
 		try {
-			log("Fetching submissions for assignment: " + it->second.name);
+			log("Fetching submissions for assignment: " + std::string(assignment.name));
 			std::this_thread::sleep_for(std::chrono::seconds(CURL_REQUEST_DELAY));  // Delay to avoid API rate limits
-			ret = fetchSubmissionsForAssignment(it->first, it->second.name);
+			ret = fetchSubmissionsForAssignment(assignment.id, assignment.name, graded_at, arena);
 		}
 		catch (const std::exception& e) {
 			log("Exception in checkSubmissions: " + std::string(e.what()));
-			++it;
 			continue;
 		}
 
 		if (ret == 1) {
-			log("Now removing \"" + it->second.name + "\"from list of ungraded assignments");
-			it = ungraded_assignments_.erase(it);
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			AssignmentInfo* entry = assignments_.find(assignment.id);
+			if (entry && !entry->graded) {
+				announceGradesReleased(assignment.name);
+
+				log("Now marking \"" + std::string(assignment.name) + "\" as graded");
+				entry->graded = true;
+				entry->graded_at = graded_at;
+				commitState();
+			}
 		}
 		else {
-			log("Assignment \"" + it->second.name + "\" is still in list of ungraded assignments.");
-			++it;
+			log("Assignment \"" + std::string(assignment.name) + "\" is still ungraded.");
 		}
 	}
 }
 
-int CanvasHandler::fetchSubmissionsForAssignment(const std::string& assignment_id, const std::string& assignment_name) {
-	log("Fetching submissions for assignment: \"" + assignment_name + "\"");
+int CanvasHandler::fetchSubmissionsForAssignment(int64_t assignment_id, std::string_view assignment_name, int64_t& graded_at, std::pmr::memory_resource* arena) {
+	log("Fetching submissions for assignment: \"" + std::string(assignment_name) + "\"");
 
-	if (assignment_id.empty() || assignment_name.empty()) {
+	if (assignment_id == 0 || assignment_name.empty()) {
 		log("Skipping submission check due to empty assignment ID or name.");
 		return -1;
 	}
 
-	CURL* curl;
-	CURLcode res;
-	std::string response_string;
-
-	curl = curl_easy_init();
-	if (!curl) {
-		log("Failed to initialize curl.");
-		return -1;
-	}
-
-	std::string url = config_.api_url + "courses/" + config_.course_id + "/assignments/" + assignment_id + "/submissions/self";
+	std::string url = config_.api_url + "courses/" + config_.course_id + "/assignments/" + std::to_string(assignment_id) + "/submissions/self";
 	log("Fetching submission URL: " + url);
 
-	curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
-
-	struct curl_slist* headers = nullptr;
-	std::string auth_header = "Authorization: Bearer " + api_token_;
-	headers = curl_slist_append(headers, auth_header.c_str());
-	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-
-	res = curl_easy_perform(curl);
-
-	if (res != CURLE_OK) {
-		log("Failed to fetch submission: " + std::string(curl_easy_strerror(res)));
-		curl_easy_cleanup(curl);
-		curl_slist_free_all(headers);
+	std::pmr::string response_string(arena);
+	HttpResponse response = performInto(canvasRequest(url), response_string);
+	if (!response.ok()) {
+		log("Failed to fetch submission: " + response.error);
 		return -1;
 	}
 
-	curl_easy_cleanup(curl);
-	curl_slist_free_all(headers);
-
 	log("Response size for submission: " + std::to_string(response_string.size()) + " bytes");
 
 	Json::Value root;
-	Json::CharReaderBuilder readerBuilder;
 	std::string errs;
 
 	try {
 		log("Parsing submission JSON...");
-		std::istringstream response_stream(response_string);
-		if (!Json::parseFromStream(readerBuilder, response_stream, &root, &errs)) {
+		if (!parseJson(response_string, root, errs)) {
 			throw std::runtime_error("Failed to parse submission JSON: " + errs);
 		}
 	}
@@ -290,22 +437,461 @@ int CanvasHandler::fetchSubmissionsForAssignment(const std::string& assignment_i
 	}
 
 	if (!isNullOrWhitespace(root["graded_at"])) {
-		std::string graded_at = root["graded_at"].asString();
-		log("Submission graded_at value: \"" + graded_at + "\"");
-
-		std::string message_content = "<@&" + config_.ping_role_id + "> Grades for \"" + assignment_name + "\" have been released.";
-		dpp::message msg(config_.discord_channel_id, message_content);
-		msg.allowed_mentions.parse_roles = true;
-		bot_.message_create(msg);
-
-		log("Grades released for assignment: " + assignment_name);
+		std::string graded_at_value = root["graded_at"].asString();
+		log("Submission graded_at value: \"" + graded_at_value + "\"");
+		graded_at = parseCanvasTimestamp(graded_at_value);
 
 		return 1;
 	}
-	log("Assignment \"" + assignment_name + "\" is still ungraded.");
+	log("Assignment \"" + std::string(assignment_name) + "\" is still ungraded.");
 	return 0;
 }
 
+void CanvasHandler::checkCourseGraphQL(std::pmr::memory_resource* arena) {
+	std::pmr::vector<AssignmentInfo> fetched_assignments(arena);
+	try {
+		std::this_thread::sleep_for(std::chrono::seconds(CURL_REQUEST_DELAY));
+		fetched_assignments = fetchAssignmentsGraphQL(arena);
+	}
+	catch (const std::exception& e) {
+		log("Exception in checkCourseGraphQL: " + std::string(e.what()));
+		return;
+	}
+
+	// Same transitions as checkAssignments followed by checkSubmissions, without the per-assignment requests
+	std::lock_guard<std::mutex> lock(state_mutex_);
+	for (const auto& assignment : fetched_assignments) {
+		if (assignment.id == 0 || assignment.name.empty() || assignment.grading_type == GradingType::NotGraded) {
+			log("Skipping assignment due to empty ID, name, or non-gradable type.");
+			continue;
+		}
+
+		AssignmentInfo tracked = assignment;
+		tracked.graded = false;
+		tracked.graded_at = 0;
+		auto [entry, inserted] = assignments_.insert(tracked);
+		if (inserted) {
+			entry->name = internName(assignment.name);
+			announceNewAssignment(assignment);
+		}
+
+		if (!entry->graded && assignment.graded) {
+			log("Submission graded_at value: " + std::to_string(assignment.graded_at));
+			announceGradesReleased(assignment.name);
+
+			log("Now marking \"" + std::string(assignment.name) + "\" as graded");
+			entry->graded = true;
+			entry->graded_at = assignment.graded_at;
+		}
+	}
+	commitState();
+
+	log("Current ungraded assignments:");
+	for (const auto& assignment : assignments_) {
+		if (!assignment.graded) {
+			log(" - " + std::string(assignment.name));
+		}
+	}
+}
+
+std::pmr::vector<AssignmentInfo> CanvasHandler::fetchAssignmentsGraphQL(std::pmr::memory_resource* arena) {
+	std::pmr::vector<AssignmentInfo> all_assignments(arena);
+	Json::Value after = Json::nullValue;
+
+	while (true) {
+		Json::Value request;
+		request["query"] = COURSE_ASSIGNMENTS_QUERY;
+		request["variables"]["courseId"] = config_.course_id;
+		request["variables"]["after"] = after;
+		request["variables"]["first"] = GRAPHQL_PAGE_SIZE;
+
+		Json::Value root = postGraphQL(request, arena);
+		const Json::Value& connection = root["data"]["course"]["assignmentsConnection"];
+		if (connection.isNull()) {
+			throw std::runtime_error("GraphQL response has no assignmentsConnection for course " + config_.course_id);
+		}
+
+		for (const auto& node : connection["nodes"]) {
+			AssignmentInfo assignment = parseAssignment(node["_id"], node["name"], node["gradingType"], arena);
+
+			const Json::Value& submission = node["submissionsConnection"]["nodes"][0];
+			assignment.graded = !isNullOrWhitespace(submission["gradedAt"]);
+			assignment.graded_at = assignment.graded ? parseCanvasTimestamp(submission["gradedAt"].asString()) : 0;
+
+			all_assignments.push_back(assignment);
+		}
+
+		const Json::Value& page_info = connection["pageInfo"];
+		if (!page_info["hasNextPage"].asBool()) {
+			break;
+		}
+		after = page_info["endCursor"];
+	}
+
+	log("Fetched " + std::to_string(all_assignments.size()) + " assignments via GraphQL");
+	return all_assignments;
+}
+
+Json::Value CanvasHandler::postGraphQL(const Json::Value& request, std::pmr::memory_resource* arena) {
+	Json::StreamWriterBuilder writerBuilder;
+	writerBuilder["indentation"] = "";
+	const std::string url = graphqlUrl();
+
+	HttpRequest http_request = canvasRequest(url);
+	http_request.body = Json::writeString(writerBuilder, request);
+	http_request.headers.push_back("Content-Type: application/json");
+
+	log("Posting GraphQL query to: " + url);
+	std::pmr::string response_string(arena);
+	HttpResponse response = performInto(std::move(http_request), response_string);
+	if (!response.ok()) {
+		throw std::runtime_error("GraphQL request failed: " + response.error);
+	}
+
+	log("Response size for GraphQL query: " + std::to_string(response_string.size()) + " bytes");
+
+	Json::Value root;
+	std::string errs;
+	if (!parseJson(response_string, root, errs)) {
+		throw std::runtime_error("Failed to parse GraphQL JSON: " + errs);
+	}
+
+	if (root.isMember("errors") && !root["errors"].empty()) {
+		throw std::runtime_error("GraphQL error: " + root["errors"][0]["message"].asString());
+	}
+
+	return root;
+}
+
+// api_url points at the REST root (".../api/v1/"), GraphQL lives next to it at ".../api/graphql"
+std::string CanvasHandler::graphqlUrl() const {
+	const std::string rest_suffix = "api/v1/";
+	std::string base = config_.api_url;
+	if (base.size() >= rest_suffix.size() && base.compare(base.size() - rest_suffix.size(), rest_suffix.size(), rest_suffix) == 0) {
+		base.erase(base.size() - rest_suffix.size());
+	}
+	else if (!base.empty() && base.back() != '/') {
+		base += '/';
+	}
+	return base + "api/graphql";
+}
+
+void CanvasHandler::startLiveEvents(const std::string& secret) {
+	// submission_updated fires for every student, we need our own user ID to pick out our grades
+	self_user_id_ = fetchSelfUserId();
+	if (self_user_id_ == 0) {
+		log("Could not determine the Canvas user ID, live events stay disabled");
+		return;
+	}
+
+	live_events_ = std::make_unique<LiveEventsListener>(bot_, config_.live_events_port, secret,
+		[this](const LiveEvent& event) { handleLiveEvent(event); });
+	live_events_->start();
+}
+
+void CanvasHandler::handleLiveEvent(const LiveEvent& event) {
+	std::lock_guard<std::mutex> lock(state_mutex_);
+
+	if (event.event_name != "assignment_created" && event.event_name != "submission_updated") {
+		return;
+	}
+	const Json::Value& context_id = event.metadata["context_id"];
+	if (!context_id.isNull() && context_id.asString() != config_.course_id) {
+		return;
+	}
+	// Only our own grades matter. The owner of the course may not run a listener and know our user ID.
+	if (event.event_name == "submission_updated" && parseCanvasId(event.body["user_id"]) != self_user_id_) {
+		return;
+	}
+
+	// Only the instance polling the course may announce for it, the others hand the event over
+	if (!shards_.holds(shardKey())) {
+		spoolLiveEvent(event);
+		return;
+	}
+	applyLiveEvent(event);
+}
+
+void CanvasHandler::applyLiveEvent(const LiveEvent& event) {
+	if (event.event_name == "assignment_created") {
+		// Unpublished assignments aren't visible to students and won't show up when polling either
+		const std::string workflow_state = event.body["workflow_state"].asString();
+		if (!workflow_state.empty() && workflow_state != "published") {
+			return;
+		}
+
+		PollArena arena(1024);
+		AssignmentInfo assignment = parseAssignment(event.body["assignment_id"], event.body["title"], event.body["grading_type"], arena.resource());
+		if (assignment.id == 0 || assignment.name.empty() || assignment.grading_type == GradingType::NotGraded) {
+			return;
+		}
+
+		auto [entry, inserted] = assignments_.insert(assignment);
+		if (inserted) {
+			entry->name = internName(assignment.name);
+			log("Live event: assignment_created " + std::to_string(assignment.id));
+			announceNewAssignment(assignment);
+			commitState();
+		}
+	}
+	else if (event.event_name == "submission_updated") {
+		AssignmentInfo* entry = assignments_.find(parseCanvasId(event.body["assignment_id"]));
+		const bool graded = !isNullOrWhitespace(event.body["graded_at"]) || event.body["workflow_state"].asString() == "graded";
+		// Live events carry the grader's view, a grade is only visible to the student once it is
+		// posted. Muted or unposted grades are left to the reconciliation poll, like submissions/self.
+		const bool posted = !isNullOrWhitespace(event.body["posted_at"]);
+
+		// Assignments we don't track yet are picked up by the next reconciliation poll
+		if (entry && !entry->graded && graded && posted) {
+			log("Live event: submission_updated for \"" + std::string(entry->name) + "\"");
+			announceGradesReleased(entry->name);
+			entry->graded = true;
+			entry->graded_at = parseCanvasTimestamp(event.body["graded_at"].asString());
+			commitState();
+		}
+	}
+}
+
+// Spooled events are "<unix ms>-<instance>-<sequence>.event" holding the event as JSON, written to
+// a temporary name first so the owner never imports half of one
+void CanvasHandler::spoolLiveEvent(const LiveEvent& event) {
+	static std::atomic<uint64_t> sequence = 0;
+	const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+
+	char stamp[32];
+	std::snprintf(stamp, sizeof(stamp), "%016lld", static_cast<long long>(now));
+	const std::string final_path = (std::filesystem::path(shards_.liveEventsInbox()) /
+		(std::string(stamp) + "-" + shards_.instanceId() + "-" + std::to_string(sequence++) + LIVE_EVENT_EXTENSION)).string();
+	const std::string temp_path = final_path + ".tmp";
+
+	Json::Value spooled;
+	spooled["metadata"] = event.metadata;
+	spooled["body"] = event.body;
+	Json::StreamWriterBuilder writerBuilder;
+	writerBuilder["indentation"] = "";
+
+	std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+	file << Json::writeString(writerBuilder, spooled);
+	file.close();
+	std::error_code error;
+	if (file) {
+		std::filesystem::rename(temp_path, final_path, error);
+	}
+	if (!file || error) {
+		log("Could not hand live event " + event.event_name + " to the instance polling the course");
+		std::filesystem::remove(temp_path, error);
+	}
+}
+
+// Applies every event spooled by other instances, oldest first, while this instance polls the course
+void CanvasHandler::importLiveEvents() {
+	namespace fs = std::filesystem;
+	std::error_code error;
+
+	std::vector<fs::path> spooled;
+	for (const auto& entry : fs::directory_iterator(shards_.liveEventsInbox(), error)) {
+		if (entry.path().extension() == LIVE_EVENT_EXTENSION) {
+			spooled.push_back(entry.path());
+		}
+	}
+	if (spooled.empty()) {
+		return;
+	}
+	std::sort(spooled.begin(), spooled.end());
+
+	std::lock_guard<std::mutex> lock(state_mutex_);
+	if (!shards_.holds(shardKey())) {
+		return; // Left for the new owner
+	}
+	for (const auto& path : spooled) {
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream contents;
+		contents << file.rdbuf();
+
+		Json::Value root;
+		std::string errs;
+		if (parseJson(contents.str(), root, errs) && root.isObject()) {
+			LiveEvent event;
+			event.metadata = root["metadata"];
+			event.body = root["body"];
+			event.event_name = event.metadata["event_name"].asString();
+			applyLiveEvent(event);
+		}
+		else {
+			log("Dropping malformed spooled live event " + path.string());
+		}
+		fs::remove(path, error);
+	}
+}
+
+std::shared_ptr<const AssignmentSnapshot> CanvasHandler::snapshot() {
+	std::shared_ptr<const AssignmentSnapshot> current = snapshot_.load();
+	if (std::chrono::steady_clock::now() - current->published_at < SNAPSHOT_TTL) {
+		return current;
+	}
+
+	// Only one reader rebuilds, and only if the poll thread isn't holding the state
+	if (!snapshot_refreshing_.exchange(true)) {
+		std::unique_lock<std::mutex> lock(state_mutex_, std::try_to_lock);
+		if (lock.owns_lock()) {
+			publishSnapshot();
+		}
+		snapshot_refreshing_ = false;
+	}
+	return snapshot_.load();
+}
+
+void CanvasHandler::publishSnapshot() {
+	auto next = std::make_shared<AssignmentSnapshot>();
+	next->assignments.reserve(assignments_.size());
+	for (const auto& assignment : assignments_) {
+		next->assignments.push_back(assignment);
+	}
+	std::sort(next->assignments.begin(), next->assignments.end(), [](const AssignmentInfo& a, const AssignmentInfo& b) {
+		return a.id < b.id;
+		});
+	next->published_at = std::chrono::steady_clock::now();
+	snapshot_.store(std::move(next));
+}
+
+void CanvasHandler::commitState() {
+	publishSnapshot();
+	shards_.storeCursor(shardKey(), serializeState());
+}
+
+std::string CanvasHandler::shardKey() const {
+	return "course:" + config_.course_id;
+}
+
+// One line per tracked assignment: id, graded, graded_at, grading type and name, tab separated
+std::string CanvasHandler::serializeState() {
+	std::string state;
+	for (const auto& assignment : assignments_) {
+		std::string name(assignment.name);
+		std::replace_if(name.begin(), name.end(), [](char c) { return c == '\t' || c == '\n'; }, ' ');
+		state += std::to_string(assignment.id) + "\t" + (assignment.graded ? "1" : "0") + "\t" +
+			std::to_string(assignment.graded_at) + "\t" + std::to_string(static_cast<int>(assignment.grading_type)) + "\t" + name + "\n";
+	}
+	return state;
+}
+
+// Merges the previous owner's state, so nothing it announced is announced again
+void CanvasHandler::restoreState(const std::string& state) {
+	std::istringstream lines(state);
+	std::string line;
+	size_t restored = 0;
+	while (std::getline(lines, line)) {
+		std::istringstream fields(line);
+		AssignmentInfo assignment;
+		int graded = 0;
+		int grading_type = 0;
+		std::string name;
+		if (!(fields >> assignment.id >> graded >> assignment.graded_at >> grading_type) || assignment.id == 0) {
+			continue;
+		}
+		fields.ignore(1);
+		std::getline(fields, name);
+
+		assignment.graded = graded != 0;
+		assignment.grading_type = static_cast<GradingType>(grading_type);
+		assignment.name = internName(name);
+
+		auto [entry, inserted] = assignments_.insert(assignment);
+		if (!inserted && assignment.graded && !entry->graded) {
+			entry->graded = true;
+			entry->graded_at = assignment.graded_at;
+		}
+		++restored;
+	}
+
+	if (restored > 0) {
+		log("Restored " + std::to_string(restored) + " assignments from the shard cursor");
+		publishSnapshot();
+	}
+}
+
+int64_t CanvasHandler::fetchSelfUserId() {
+	HttpResponse response = http_.perform(canvasRequest(config_.api_url + "users/self"));
+	if (!response.ok()) {
+		log("Failed to fetch users/self: " + response.error);
+		return 0;
+	}
+
+	const std::string& response_string = response.body;
+	Json::Value root;
+	Json::CharReaderBuilder readerBuilder;
+	std::string errs;
+	std::istringstream response_stream(response_string);
+	if (!Json::parseFromStream(readerBuilder, response_stream, &root, &errs)) {
+		log("Failed to parse users/self JSON: " + errs);
+		return 0;
+	}
+
+	return parseCanvasId(root["id"]);
+}
+
+void CanvasHandler::announceNewAssignment(const AssignmentInfo& assignment) {
+	std::string message_content = "<@&" + config_.ping_role_id + "> A new assignment \"" + std::string(assignment.name) + "\" was added.";
+	dpp::message msg(config_.discord_channel_id, message_content);
+	msg.allowed_mentions.parse_roles = true;
+	bot_.message_create(msg);
+
+	log("New assignment: " + std::string(assignment.name));
+}
+
+void CanvasHandler::announceGradesReleased(std::string_view assignment_name) {
+	std::string message_content = "<@&" + config_.ping_role_id + "> Grades for \"" + std::string(assignment_name) + "\" have been released.";
+	dpp::message msg(config_.discord_channel_id, message_content);
+	msg.allowed_mentions.parse_roles = true;
+	bot_.message_create(msg);
+
+	log("Grades released for assignment: " + std::string(assignment_name));
+}
+
+HttpRequest CanvasHandler::canvasRequest(const std::string& url) const {
+	HttpRequest request;
+	request.url = url;
+	request.headers.push_back("Authorization: Bearer " + api_token_);
+	return request;
+}
+
+// The name is copied into the arena, callers intern it only once the assignment is tracked
+AssignmentInfo CanvasHandler::parseAssignment(const Json::Value& id, const Json::Value& name, const Json::Value& grading_type, std::pmr::memory_resource* arena) {
+	AssignmentInfo assignment;
+	assignment.id = parseCanvasId(id);
+
+	const char* begin = nullptr;
+	const char* end = nullptr;
+	if (name.isString() && name.getString(&begin, &end) && begin != end) {
+		const size_t length = static_cast<size_t>(end - begin);
+		char* copy = static_cast<char*>(arena->allocate(length, 1));
+		std::memcpy(copy, begin, length);
+		assignment.name = std::string_view(copy, length);
+	}
+
+	assignment.grading_type = parseGradingType(grading_type.asString());
+	return assignment;
+}
+
+std::string_view CanvasHandler::internName(std::string_view name) {
+	std::lock_guard<std::mutex> lock(names_mutex_);
+	return names_.intern(name);
+}
+
+HttpResponse CanvasHandler::performInto(HttpRequest request, std::pmr::string& body) {
+	request.on_data = [&body](const char* data, size_t size) {
+		try {
+			body.append(data, size);
+			return true;
+		}
+		catch (const std::bad_alloc&) {
+			return false;
+		}
+	};
+	return http_.perform(std::move(request));
+}
+
 void CanvasHandler::log(const std::string& message) {
 	bot_.log(dpp::ll_info, message);
 }
@@ -7,33 +7,92 @@
 #include <vector>
 #include <chrono>
 #include <json/json.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <memory_resource>
+#include "assignment_table.h"
+#include "live_events_listener.h"
+#include "http_client.h"
+#include "poll_arena.h"
+#include "shard_coordinator.h"
 
-struct AssignmentInfo {
-	std::string id;
-	std::string name;
-	std::string grading_type;
-	bool graded;
-	std::string graded_at;
+// Immutable copy of the tracked assignments handed out to readers such as slash commands.
+// Names point into the handler's interner, which never frees strings.
+struct AssignmentSnapshot {
+	std::vector<AssignmentInfo> assignments;
+	std::chrono::steady_clock::time_point published_at;
 };
 
 class CanvasHandler {
 public:
-	CanvasHandler(dpp::cluster& bot, CanvasConfig& config, const std::string& api_token);
+	CanvasHandler(dpp::cluster& bot, HttpClient& http, ShardCoordinator& shards, CanvasConfig& config, const std::string& api_token);
 	void start();
 
+	// Push mode, grade releases arrive as Canvas live events and polling only reconciles
+	void startLiveEvents(const std::string& secret);
+
+	// Lock free for readers. A snapshot older than the TTL is rebuilt from memory if the
+	// state lock is free, otherwise the stale one is returned. Never calls the Canvas API.
+	std::shared_ptr<const AssignmentSnapshot> snapshot();
+
 private:
 	dpp::cluster& bot_;
+	HttpClient& http_;
+	ShardCoordinator& shards_;
 	CanvasConfig& config_;
 	std::string api_token_;
 
-	std::unordered_map<std::string, AssignmentInfo> assignments_;
-	std::unordered_map<std::string, AssignmentInfo> ungraded_assignments_;
+	// Every tracked assignment, ungraded ones are those with graded == false.
+	// Guarded by state_mutex_ since live events update it from the listener's connection threads,
+	// which also reads config_ under the same lock.
+	AssignmentTable assignments_;
+	std::mutex state_mutex_;
+
+	StringInterner names_;
+	std::mutex names_mutex_;
+
+	std::atomic<std::shared_ptr<const AssignmentSnapshot>> snapshot_;
+	std::atomic<bool> snapshot_refreshing_ = false;
+
+	std::unique_ptr<LiveEventsListener> live_events_;
+	int64_t self_user_id_ = 0;
 
 	bool isNullOrWhitespace(const Json::Value& value) const;
-	void checkAssignments();
-	void checkSubmissions();
-	std::vector<AssignmentInfo> fetchAssignments();
-	int fetchSubmissionsForAssignment(const std::string& assignment_id, const std::string& assignment_name);
+	// Everything below that takes an arena allocates its transient data from the poll cycle's arena
+	void checkAssignments(std::pmr::memory_resource* arena);
+	void checkSubmissions(std::pmr::memory_resource* arena);
+	std::pmr::vector<AssignmentInfo> fetchAssignments(std::pmr::memory_resource* arena);
+	void appendAssignmentsPage(const HttpResponse& response, int page, std::pmr::vector<AssignmentInfo>& assignments, std::pmr::memory_resource* arena);
+	int fetchSubmissionsForAssignment(int64_t assignment_id, std::string_view assignment_name, int64_t& graded_at, std::pmr::memory_resource* arena);
+	AssignmentInfo parseAssignment(const Json::Value& id, const Json::Value& name, const Json::Value& grading_type, std::pmr::memory_resource* arena);
+	std::string_view internName(std::string_view name);
+	HttpResponse performInto(HttpRequest request, std::pmr::string& body);
+
+	// GraphQL mode, assignments and grading status in one paginated query
+	void checkCourseGraphQL(std::pmr::memory_resource* arena);
+	std::pmr::vector<AssignmentInfo> fetchAssignmentsGraphQL(std::pmr::memory_resource* arena);
+	Json::Value postGraphQL(const Json::Value& request, std::pmr::memory_resource* arena);
+	std::string graphqlUrl() const;
+
+	HttpRequest canvasRequest(const std::string& url) const;
+
+	void handleLiveEvent(const LiveEvent& event);
+	void applyLiveEvent(const LiveEvent& event); // Caller holds state_mutex_ and the course's lease
+	// Hands an event for a course polled by another instance to it through the shard state
+	void spoolLiveEvent(const LiveEvent& event); // Caller holds state_mutex_
+	void importLiveEvents();
+	void publishSnapshot(); // Caller holds state_mutex_
+
+	// After a state change: publishes the snapshot and stores the shard cursor. Caller holds state_mutex_.
+	void commitState();
+	std::string shardKey() const;
+	std::string serializeState();
+	void restoreState(const std::string& state);
+	int64_t fetchSelfUserId();
+
+	void announceNewAssignment(const AssignmentInfo& assignment);
+	void announceGradesReleased(std::string_view assignment_name);
 
 	void log(const std::string& message);
 };
\ No newline at end of file
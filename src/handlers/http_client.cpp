@@ -0,0 +1,266 @@
+#include "http_client.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+constexpr long CONNECT_TIMEOUT_SECONDS = 15;
+constexpr long TRANSFER_TIMEOUT_SECONDS = 60;
+// Only the start of an error response is kept, it is just for the log
+constexpr size_t MAX_ERROR_BODY_BYTES = 4096;
+constexpr auto STATS_LOG_INTERVAL = std::chrono::minutes(10);
+
+HttpClient::HttpClient(dpp::cluster& bot, const TransportConfig& config)
+	: bot_(bot), config_(config) {
+	// Not thread safe, has to run before any other thread uses curl
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+
+	multi_ = curl_multi_init();
+	if (!multi_) {
+		throw std::runtime_error("Failed to initialize curl multi handle.");
+	}
+
+	if (config_.http2) {
+		curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+	}
+	if (config_.max_host_connections > 0) {
+		curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(config_.max_host_connections));
+	}
+
+	thread_ = std::thread([this]() { run(); });
+}
+
+HttpClient::~HttpClient() {
+	running_ = false;
+	curl_multi_wakeup(multi_);
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+	curl_multi_cleanup(multi_);
+}
+
+std::future<HttpResponse> HttpClient::submit(HttpRequest request) {
+	auto transfer = std::make_unique<Transfer>();
+	transfer->request = std::move(request);
+	transfer->host = hostOf(transfer->request.url);
+	std::future<HttpResponse> result = transfer->promise.get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(pending_mutex_);
+		pending_.push_back(std::move(transfer));
+	}
+	curl_multi_wakeup(multi_);
+	return result;
+}
+
+HttpResponse HttpClient::perform(HttpRequest request) {
+	return submit(std::move(request)).get();
+}
+
+std::unordered_map<std::string, HostStats> HttpClient::stats() const {
+	std::lock_guard<std::mutex> lock(stats_mutex_);
+	return stats_;
+}
+
+void HttpClient::logStats() const {
+	for (const auto& [host, stats] : this->stats()) {
+		const uint64_t average_ms = stats.requests ? stats.total_time_us / stats.requests / 1000 : 0;
+		bot_.log(dpp::ll_info, "HTTP " + host + ": " + std::to_string(stats.requests) + " requests (" +
+			std::to_string(stats.http2_requests) + " over HTTP/2), " + std::to_string(stats.wire_bytes) + " bytes on wire, " +
+			std::to_string(stats.decoded_bytes) + " bytes decoded, " + std::to_string(average_ms) + " ms average");
+	}
+}
+
+void HttpClient::run() {
+	auto next_stats_log = std::chrono::steady_clock::now() + STATS_LOG_INTERVAL;
+
+	while (running_) {
+		std::deque<std::unique_ptr<Transfer>> starting;
+		{
+			std::lock_guard<std::mutex> lock(pending_mutex_);
+			starting.swap(pending_);
+		}
+		for (auto& transfer : starting) {
+			startTransfer(std::move(transfer));
+		}
+
+		int running_handles = 0;
+		curl_multi_perform(multi_, &running_handles);
+
+		int queued = 0;
+		while (CURLMsg* message = curl_multi_info_read(multi_, &queued)) {
+			if (message->msg == CURLMSG_DONE) {
+				finishTransfer(message->easy_handle, message->data.result);
+			}
+		}
+
+		if (std::chrono::steady_clock::now() >= next_stats_log) {
+			logStats();
+			next_stats_log += STATS_LOG_INTERVAL;
+		}
+
+		// Sleeps until there is socket activity, a timeout is due, or submit() wakes us
+		curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+	}
+}
+
+void HttpClient::startTransfer(std::unique_ptr<Transfer> transfer) {
+	CURL* easy = curl_easy_init();
+	if (!easy) {
+		transfer->response.result = CURLE_FAILED_INIT;
+		transfer->response.error = "Failed to initialize curl.";
+		transfer->promise.set_value(std::move(transfer->response));
+		return;
+	}
+
+	transfer->easy = easy;
+	const HttpRequest& request = transfer->request;
+	curl_easy_setopt(easy, CURLOPT_URL, request.url.c_str());
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, onWrite);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, transfer.get());
+	curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, onHeader);
+	curl_easy_setopt(easy, CURLOPT_HEADERDATA, transfer.get());
+	curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer.get());
+	curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, CONNECT_TIMEOUT_SECONDS);
+	curl_easy_setopt(easy, CURLOPT_TIMEOUT, TRANSFER_TIMEOUT_SECONDS);
+	curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+
+	if (config_.http2) {
+		// HTTP/2 over TLS when the server offers it, and wait for an existing connection to multiplex on.
+		// Cleartext stays HTTP/1.1, where waiting would only serialize transfers on one connection.
+		curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+		if (request.url.rfind("https://", 0) == 0) {
+			curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+		}
+	}
+	if (config_.compression) {
+		// Empty string advertises every encoding this libcurl can decode (gzip, deflate, br, ...)
+		curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, "");
+	}
+
+	for (const auto& header : request.headers) {
+		transfer->headers = curl_slist_append(transfer->headers, header.c_str());
+	}
+	if (transfer->headers) {
+		curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->headers);
+	}
+
+	if (!request.body.empty()) {
+		curl_easy_setopt(easy, CURLOPT_POSTFIELDS, request.body.c_str());
+		curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, static_cast<long>(request.body.size()));
+	}
+
+	curl_multi_add_handle(multi_, easy);
+	transfer.release(); // Owned through CURLOPT_PRIVATE until finishTransfer
+}
+
+void HttpClient::finishTransfer(CURL* easy, CURLcode result) {
+	Transfer* raw_transfer = nullptr;
+	curl_easy_getinfo(easy, CURLINFO_PRIVATE, &raw_transfer);
+	std::unique_ptr<Transfer> transfer(raw_transfer);
+
+	transfer->response.result = result;
+	curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &transfer->response.status);
+	if (result != CURLE_OK) {
+		transfer->response.error = curl_easy_strerror(result);
+	}
+	else if (!transfer->response.ok()) {
+		transfer->response.error = "HTTP " + std::to_string(transfer->response.status);
+	}
+
+	curl_off_t wire_bytes = 0;
+	curl_off_t total_time_us = 0;
+	long http_version = 0;
+	curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD_T, &wire_bytes);
+	curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &total_time_us);
+	curl_easy_getinfo(easy, CURLINFO_HTTP_VERSION, &http_version);
+
+	{
+		std::lock_guard<std::mutex> lock(stats_mutex_);
+		HostStats& stats = stats_[transfer->host];
+		++stats.requests;
+		stats.http2_requests += http_version == CURL_HTTP_VERSION_2_0 ? 1 : 0;
+		stats.wire_bytes += static_cast<uint64_t>(wire_bytes);
+		stats.decoded_bytes += transfer->decoded_bytes;
+		stats.total_time_us += static_cast<uint64_t>(total_time_us);
+	}
+
+	curl_multi_remove_handle(multi_, easy);
+	curl_easy_cleanup(easy);
+	curl_slist_free_all(transfer->headers);
+
+	transfer->promise.set_value(std::move(transfer->response));
+}
+
+size_t HttpClient::onWrite(char* data, size_t size, size_t nmemb, void* userdata) {
+	Transfer* transfer = static_cast<Transfer*>(userdata);
+	const size_t length = size * nmemb;
+	transfer->decoded_bytes += length;
+
+	// Error pages (401, 429, 5xx...) never reach the caller's parser
+	long status = 0;
+	curl_easy_getinfo(transfer->easy, CURLINFO_RESPONSE_CODE, &status);
+	const bool success = status >= 200 && status < 300;
+
+	if (transfer->request.on_data && success) {
+		return transfer->request.on_data(data, length) ? length : 0;
+	}
+
+	try {
+		if (success || transfer->response.body.size() < MAX_ERROR_BODY_BYTES) {
+			transfer->response.body.append(data, success ? length : std::min(length, MAX_ERROR_BODY_BYTES - transfer->response.body.size()));
+		}
+		return length;
+	}
+	catch (const std::bad_alloc& e) {
+		return 0;
+	}
+}
+
+size_t HttpClient::onHeader(char* data, size_t size, size_t nmemb, void* userdata) {
+	Transfer* transfer = static_cast<Transfer*>(userdata);
+	const size_t length = size * nmemb;
+	const std::string_view line(data, length);
+
+	// A status line starts the headers of a new response (redirect, 100 Continue)
+	if (line.rfind("HTTP/", 0) == 0) {
+		transfer->response.headers.clear();
+		return length;
+	}
+
+	const size_t colon = line.find(':');
+	if (colon == std::string_view::npos) {
+		return length;
+	}
+	auto trim = [](std::string_view value) {
+		const size_t start = value.find_first_not_of(" \t\r\n");
+		const size_t end = value.find_last_not_of(" \t\r\n");
+		return start == std::string_view::npos ? std::string_view() : value.substr(start, end - start + 1);
+	};
+
+	try {
+		transfer->response.headers.emplace_back(std::string(trim(line.substr(0, colon))), std::string(trim(line.substr(colon + 1))));
+		return length;
+	}
+	catch (const std::bad_alloc& e) {
+		return 0;
+	}
+}
+
+std::string HttpResponse::header(std::string_view name) const {
+	for (auto it = headers.rbegin(); it != headers.rend(); ++it) {
+		const std::string& candidate = it->first;
+		if (candidate.size() == name.size() && std::equal(candidate.begin(), candidate.end(), name.begin(), [](char a, char b) {
+			return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+			})) {
+			return it->second;
+		}
+	}
+	return {};
+}
+
+std::string HttpClient::hostOf(const std::string& url) {
+	size_t start = url.find("://");
+	start = start == std::string::npos ? 0 : start + 3;
+	const size_t end = url.find_first_of(":/?", start);
+	return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <dpp/dpp.h>
+#include <curl/curl.h>
+#include "../config/config.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+struct HttpRequest {
+	std::string url;
+	std::vector<std::string> headers;
+	std::string body; // Sent as a POST when not empty
+
+	// Receives the decoded body of a 2xx response chunk by chunk on the transport thread, return
+	// false to abort. When unset, or for any other status, the body is buffered into HttpResponse::body.
+	std::function<bool(const char* data, size_t size)> on_data;
+};
+
+struct HttpResponse {
+	CURLcode result = CURLE_OK;
+	long status = 0;
+	std::string body;
+	std::string error; // curl's message, or "HTTP <status>" when the server answered with an error
+	std::vector<std::pair<std::string, std::string>> headers; // Of the final response when redirected
+
+	// The transfer completed and the server answered 2xx
+	bool ok() const noexcept { return result == CURLE_OK && status >= 200 && status < 300; }
+
+	// Value of the named header (case insensitive), empty if absent
+	std::string header(std::string_view name) const;
+};
+
+struct HostStats {
+	uint64_t requests = 0;
+	uint64_t http2_requests = 0;
+	uint64_t wire_bytes = 0;    // Body bytes as received, before content decoding
+	uint64_t decoded_bytes = 0; // Body bytes after decoding
+	uint64_t total_time_us = 0;
+};
+
+// Runs every transfer on one curl multi handle driven by a single thread, so concurrent
+// requests from any thread share connections: with HTTP/2 enabled they are multiplexed over
+// one connection per host. Bodies are decoded (gzip/br/...) as they stream in.
+class HttpClient {
+public:
+	HttpClient(dpp::cluster& bot, const TransportConfig& config);
+	~HttpClient();
+
+	HttpClient(const HttpClient&) = delete;
+	HttpClient& operator=(const HttpClient&) = delete;
+
+	std::future<HttpResponse> submit(HttpRequest request);
+
+	// Blocking convenience wrapper around submit
+	HttpResponse perform(HttpRequest request);
+
+	std::unordered_map<std::string, HostStats> stats() const;
+	void logStats() const;
+
+private:
+	struct Transfer {
+		HttpRequest request;
+		HttpResponse response;
+		std::promise<HttpResponse> promise;
+		CURL* easy = nullptr;
+		curl_slist* headers = nullptr;
+		uint64_t decoded_bytes = 0;
+		std::string host;
+	};
+
+	dpp::cluster& bot_;
+	TransportConfig config_;
+	CURLM* multi_ = nullptr;
+	std::thread thread_;
+	std::atomic<bool> running_ = true;
+
+	std::deque<std::unique_ptr<Transfer>> pending_;
+	std::mutex pending_mutex_;
+
+	std::unordered_map<std::string, HostStats> stats_;
+	mutable std::mutex stats_mutex_;
+
+	void run();
+	void startTransfer(std::unique_ptr<Transfer> transfer);
+	void finishTransfer(CURL* easy, CURLcode result);
+
+	static size_t onWrite(char* data, size_t size, size_t nmemb, void* userdata);
+	static size_t onHeader(char* data, size_t size, size_t nmemb, void* userdata);
+	static std::string hostOf(const std::string& url);
+};
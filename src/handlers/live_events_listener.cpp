@@ -0,0 +1,273 @@
+#include "live_events_listener.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+constexpr size_t MAX_HEADER_BYTES = 16 * 1024;
+constexpr size_t MAX_BODY_BYTES = 1024 * 1024;
+constexpr int SOCKET_TIMEOUT_SECONDS = 5;
+// A request has this long to arrive in full, however slowly its bytes trickle in
+constexpr auto CONNECTION_DEADLINE = std::chrono::seconds(10);
+constexpr int MAX_CONNECTIONS = 16;
+constexpr auto ACCEPT_RETRY_DELAY = std::chrono::milliseconds(250);
+
+static std::string toLower(std::string value) {
+	std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+	return value;
+}
+
+static void sendResponse(int client_fd, int status, const std::string& reason) {
+	const std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason +
+		"\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+	send(client_fd, response.data(), response.size(), MSG_NOSIGNAL);
+}
+
+// recv that gives up once the connection's deadline has passed
+static ssize_t receiveBefore(int client_fd, char* buffer, size_t size, std::chrono::steady_clock::time_point deadline) {
+	const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+	if (remaining.count() <= 0) {
+		return -1;
+	}
+	pollfd readable{ client_fd, POLLIN, 0 };
+	if (poll(&readable, 1, static_cast<int>(remaining.count())) <= 0) {
+		return -1;
+	}
+	return recv(client_fd, buffer, size, 0);
+}
+
+LiveEventsListener::LiveEventsListener(dpp::cluster& bot, int port, const std::string& secret, EventCallback on_event)
+	: bot_(bot), port_(port), secret_(secret), on_event_(std::move(on_event)) {
+	if (secret_.empty()) {
+		throw std::runtime_error("Live events listener needs a shared secret");
+	}
+
+	listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd_ < 0) {
+		throw std::runtime_error("Could not create live events socket");
+	}
+
+	int reuse = 1;
+	setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(static_cast<uint16_t>(port_));
+
+	if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listen_fd_, 64) < 0) {
+		close(listen_fd_);
+		throw std::runtime_error("Could not listen for live events on port " + std::to_string(port_));
+	}
+}
+
+LiveEventsListener::~LiveEventsListener() {
+	running_ = false;
+	if (listen_fd_ >= 0) {
+		shutdown(listen_fd_, SHUT_RDWR);
+		close(listen_fd_);
+	}
+}
+
+void LiveEventsListener::start() {
+	running_ = true;
+	std::thread([this]() {
+		serve();
+		}).detach();
+	bot_.log(dpp::ll_info, "Listening for Canvas live events on port " + std::to_string(port_));
+}
+
+void LiveEventsListener::serve() {
+	while (running_) {
+		int client_fd = accept(listen_fd_, nullptr, nullptr);
+		if (client_fd < 0) {
+			const int error = errno;
+			if (!running_ || error == EBADF || error == EINVAL) {
+				// The listening socket was shut down or closed
+				return;
+			}
+			if (error != EINTR && error != ECONNABORTED) {
+				// Out of descriptors or buffers, retrying right away would just spin
+				bot_.log(dpp::ll_error, "Accepting a live events connection failed: " + std::string(std::strerror(error)));
+				std::this_thread::sleep_for(ACCEPT_RETRY_DELAY);
+			}
+			continue;
+		}
+
+		// A response to a client that stops reading must not hold the connection either
+		timeval timeout{ SOCKET_TIMEOUT_SECONDS, 0 };
+		setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		if (active_connections_ >= MAX_CONNECTIONS) {
+			sendResponse(client_fd, 503, "Service Unavailable");
+			close(client_fd);
+			continue;
+		}
+
+		// Each connection gets its own thread, so a slow client only delays itself
+		++active_connections_;
+		std::thread([this, client_fd]() {
+			try {
+				handleConnection(client_fd, std::chrono::steady_clock::now() + CONNECTION_DEADLINE);
+			}
+			catch (const std::exception& e) {
+				bot_.log(dpp::ll_error, "Exception while handling live event: " + std::string(e.what()));
+				sendResponse(client_fd, 500, "Internal Server Error");
+			}
+			close(client_fd);
+			--active_connections_;
+			}).detach();
+	}
+}
+
+void LiveEventsListener::handleConnection(int client_fd, std::chrono::steady_clock::time_point deadline) {
+	std::string request;
+	char buffer[4096];
+	size_t header_end = std::string::npos;
+
+	while ((header_end = request.find("\r\n\r\n")) == std::string::npos) {
+		if (request.size() > MAX_HEADER_BYTES) {
+			sendResponse(client_fd, 431, "Request Header Fields Too Large");
+			return;
+		}
+		ssize_t received = receiveBefore(client_fd, buffer, sizeof(buffer), deadline);
+		if (received <= 0) {
+			if (std::chrono::steady_clock::now() >= deadline) {
+				sendResponse(client_fd, 408, "Request Timeout");
+			}
+			return;
+		}
+		request.append(buffer, static_cast<size_t>(received));
+	}
+
+	std::istringstream head(request.substr(0, header_end));
+	std::string method, target, line;
+	head >> method >> target;
+	std::getline(head, line);
+
+	size_t content_length = 0;
+	bool valid_content_length = true;
+	std::string authorization;
+	while (std::getline(head, line)) {
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		const size_t colon = line.find(':');
+		if (colon == std::string::npos) {
+			continue;
+		}
+		const std::string name = toLower(line.substr(0, colon));
+		const size_t value_start = line.find_first_not_of(' ', colon + 1);
+		const size_t value_end = line.find_last_not_of(" \t");
+		const std::string value = value_start == std::string::npos ? "" : line.substr(value_start, value_end + 1 - value_start);
+		if (name == "content-length") {
+			const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), content_length);
+			if (error == std::errc::result_out_of_range) {
+				// Answered with 413 below, like any other oversized body
+				content_length = std::numeric_limits<size_t>::max();
+			}
+			else if (error != std::errc() || end != value.data() + value.size()) {
+				valid_content_length = false;
+			}
+		}
+		else if (name == "authorization") {
+			authorization = value;
+		}
+	}
+
+	if (method != "POST") {
+		sendResponse(client_fd, 405, "Method Not Allowed");
+		return;
+	}
+	if (!isAuthorized(authorization)) {
+		bot_.log(dpp::ll_warning, "Rejected live event with bad credentials");
+		sendResponse(client_fd, 401, "Unauthorized");
+		return;
+	}
+	if (!valid_content_length) {
+		sendResponse(client_fd, 400, "Bad Request");
+		return;
+	}
+	if (content_length > MAX_BODY_BYTES) {
+		sendResponse(client_fd, 413, "Payload Too Large");
+		return;
+	}
+
+	std::string payload = request.substr(header_end + 4);
+	while (payload.size() < content_length) {
+		ssize_t received = receiveBefore(client_fd, buffer, std::min(sizeof(buffer), content_length - payload.size()), deadline);
+		if (received <= 0) {
+			if (std::chrono::steady_clock::now() >= deadline) {
+				sendResponse(client_fd, 408, "Request Timeout");
+			}
+			return;
+		}
+		payload.append(buffer, static_cast<size_t>(received));
+	}
+	payload.resize(content_length);
+
+	const int dispatched = dispatch(payload);
+	if (dispatched < 0) {
+		sendResponse(client_fd, 400, "Bad Request");
+		return;
+	}
+	sendResponse(client_fd, 204, "No Content");
+}
+
+// Constant time so the secret can't be recovered from response timing
+bool LiveEventsListener::isAuthorized(const std::string& authorization) const {
+	const std::string expected = "Bearer " + secret_;
+	if (authorization.size() != expected.size()) {
+		return false;
+	}
+	unsigned char difference = 0;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		difference |= static_cast<unsigned char>(authorization[i] ^ expected[i]);
+	}
+	return difference == 0;
+}
+
+// Returns the number of events handed to the callback, or -1 if the payload isn't valid
+int LiveEventsListener::dispatch(const std::string& payload) {
+	Json::Value root;
+	Json::CharReaderBuilder readerBuilder;
+	std::string errs;
+	std::istringstream payload_stream(payload);
+	if (!Json::parseFromStream(readerBuilder, payload_stream, &root, &errs)) {
+		bot_.log(dpp::ll_warning, "Failed to parse live event JSON: " + errs);
+		return -1;
+	}
+
+	Json::Value events(Json::arrayValue);
+	if (root.isArray()) {
+		events = root;
+	}
+	else {
+		events.append(root);
+	}
+
+	int dispatched = 0;
+	for (const auto& event_json : events) {
+		LiveEvent event;
+		event.metadata = event_json["metadata"];
+		event.body = event_json["body"];
+		event.event_name = event.metadata["event_name"].asString();
+		if (event.event_name.empty()) {
+			continue;
+		}
+		on_event_(event);
+		++dispatched;
+	}
+	return dispatched;
+}
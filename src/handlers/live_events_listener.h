@@ -0,0 +1,44 @@
+#pragma once
+
+#include <dpp/dpp.h>
+#include <json/json.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+
+struct LiveEvent {
+	std::string event_name;
+	Json::Value metadata;
+	Json::Value body;
+};
+
+// Minimal HTTP/1.1 endpoint for Canvas Live Events. Every POST must carry
+// "Authorization: Bearer <secret>", the JSON payload (one event or an array of
+// events) is parsed and handed to the callback on the connection's thread.
+class LiveEventsListener {
+public:
+	using EventCallback = std::function<void(const LiveEvent&)>;
+
+	LiveEventsListener(dpp::cluster& bot, int port, const std::string& secret, EventCallback on_event);
+	~LiveEventsListener();
+
+	LiveEventsListener(const LiveEventsListener&) = delete;
+	LiveEventsListener& operator=(const LiveEventsListener&) = delete;
+
+	void start();
+
+private:
+	dpp::cluster& bot_;
+	int port_;
+	std::string secret_;
+	EventCallback on_event_;
+	int listen_fd_ = -1;
+	std::atomic<bool> running_ = false;
+	std::atomic<int> active_connections_ = 0;
+
+	void serve();
+	void handleConnection(int client_fd, std::chrono::steady_clock::time_point deadline);
+	bool isAuthorized(const std::string& authorization) const;
+	int dispatch(const std::string& payload);
+};
@@ -1,5 +1,4 @@
 ﻿#include "rss_feed_handler.h"
-#include <curl/curl.h>
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 #include <thread>
@@ -7,6 +6,11 @@
 #include <sstream>
 #include <stdexcept>
 
+// Upper bound on feeds being fetched at the same time
+constexpr size_t RSS_FETCH_WORKERS = 8;
+// How often, in ticks, the primary archives what other instances spooled for it
+constexpr uint64_t ARCHIVE_IMPORT_TICKS = 10;
+
 std::string decodeHTMLEntities(const std::string& input) {
 	static const std::unordered_map<std::string, std::string> htmlEntities = {
 		{"&nbsp;", " "},
@@ -88,90 +92,180 @@ std::string convertHTMLToMarkdown(const std::string& input) {
 	return output;
 }
 
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* s) {
-	size_t newLength = size * nmemb;
-	try {
-		s->append((char*)contents, newLength);
-	}
-	catch (std::bad_alloc& e) {
-		return 0;
-	}
-	return newLength;
-}
+RSSFeedHandler::RSSFeedHandler(dpp::cluster& bot, HttpClient& http, AnnouncementArchive* archive, ShardCoordinator& shards, const Config& config)
+	: bot_(bot), http_(http), archive_(archive), shards_(shards), config_(config), start_time_(std::chrono::steady_clock::now()), fetch_pool_(RSS_FETCH_WORKERS) {
+	// libxml2 doesn't initialize itself thread safely on first use, do it before any fetch threads exist
+	installXmlArenaAllocator();
+
+	std::unordered_map<std::string, size_t> source_index;
 
-RSSFeedHandler::RSSFeedHandler(dpp::cluster& bot, const Config& config)
-	: bot_(bot), config_(config) {
 	for (const auto& feed_config : config_.getRSSFeeds()) {
-		feed_states_.emplace_back(FeedState{
-			feed_config,
-			"",
-			std::chrono::steady_clock::now()
+		auto [it, inserted] = source_index.try_emplace(feed_config.feed_url, feed_sources_.size());
+		if (inserted) {
+			feed_sources_.emplace_back(FeedSource{
+				feed_config.feed_url,
+				feed_config.check_interval,
+				{},
+				""
+				});
+		}
+
+		FeedSource& source = feed_sources_[it->second];
+		source.check_interval = std::min(source.check_interval, feed_config.check_interval);
+
+		// The same channel/role pair listed twice should still only get one message
+		bool subscribed = std::any_of(source.subscribers.begin(), source.subscribers.end(), [&](const FeedSubscriber& subscriber) {
+			return subscriber.discord_channel_id == feed_config.discord_channel_id && subscriber.ping_role_id == feed_config.ping_role_id;
 			});
+		if (!subscribed) {
+			source.subscribers.push_back({ feed_config.discord_channel_id, feed_config.ping_role_id });
+		}
+	}
+
+	// Spread the first fetch of every source over its interval so feeds sharing an
+	// interval don't all hit upstream in the same second
+	std::mt19937 rng(std::random_device{}());
+	for (size_t i = 0; i < feed_sources_.size(); ++i) {
+		const int interval = std::max(feed_sources_[i].check_interval, 1);
+		const uint64_t offset = std::uniform_int_distribution<uint64_t>(1, static_cast<uint64_t>(interval))(rng);
+		schedule_.schedule(offset, FeedTimer{ i, offset });
 	}
+
+	bot_.log(dpp::ll_info, "RSSFeedHandler tracking " + std::to_string(feed_sources_.size()) + " unique feeds for " +
+		std::to_string(config_.getRSSFeeds().size()) + " subscriptions");
 }
 
 void RSSFeedHandler::start() {
 	std::thread([this]() {
+		uint64_t tick = 0;
 		while (true) {
-			checkFeeds();
-			std::this_thread::sleep_for(std::chrono::seconds(1));
+			// Sleep to absolute tick boundaries so a slow iteration doesn't drift the schedule
+			++tick;
+			std::this_thread::sleep_until(start_time_ + std::chrono::seconds(tick));
+			checkFeeds(tick);
 		}
 		}).detach();
 }
 
-void RSSFeedHandler::checkFeeds() {
-	const auto now = std::chrono::steady_clock::now();
-	for (auto& feed_state : feed_states_) {
-		if (now >= feed_state.next_check) {
-			FeedItem latest_item = fetchLatestItem(feed_state.config.feed_url);
-
-			if (!latest_item.title.empty() && latest_item.title != feed_state.last_item_guid) {
-				feed_state.last_item_guid = latest_item.title;
+void RSSFeedHandler::checkFeeds(uint64_t tick) {
+	std::vector<FeedTimer> due;
+	{
+		std::lock_guard<std::mutex> lock(schedule_mutex_);
+		schedule_.advance(tick, [&due](FeedTimer&& timer) {
+			due.push_back(timer);
+			});
+	}
 
-				std::string message_content = "📢 **" + latest_item.title +
-					"**\n\n---" + latest_item.content + "---\n\nSee full announcement here: " + latest_item.feed_url +
-					"\n<@&" + feed_state.config.ping_role_id + ">";
+	// Fetching happens on the pool so one slow feed doesn't hold up the rest
+	for (const auto& timer : due) {
+		fetch_pool_.submit([this, timer]() {
+			pollSource(timer);
+			});
+	}
 
-				dpp::message msg(feed_state.config.discord_channel_id, message_content);
-				msg.allowed_mentions.parse_roles = true;
-				bot_.message_create(msg);
+	if (archive_ != nullptr && shards_.enabled() && tick % ARCHIVE_IMPORT_TICKS == 0) {
+		fetch_pool_.submit([this]() {
+			const size_t imported = archive_->importSpool(shards_.archiveInbox());
+			if (imported > 0) {
+				bot_.log(dpp::ll_info, "Archived " + std::to_string(imported) + " announcements from other instances");
 			}
+			});
+	}
 
-			feed_state.next_check = now + std::chrono::seconds(feed_state.config.check_interval);
-		}
+	if (!due.empty() && fetch_pool_.pending() > RSS_FETCH_WORKERS * 4) {
+		bot_.log(dpp::ll_warning, "RSS fetch backlog: " + std::to_string(fetch_pool_.pending()) + " feeds waiting for a worker");
 	}
 }
 
-// Fetch using libcurl and libxml2
-FeedItem RSSFeedHandler::fetchLatestItem(const std::string& feed_url) {
-	CURL* curl;
-	CURLcode res;
-	std::string rss_content;
+void RSSFeedHandler::pollSource(const FeedTimer& timer) {
+	FeedSource& source = feed_sources_[timer.source_index];
+
+	// In sharded mode the feed may belong to another instance. It stays scheduled either way so
+	// this instance notices when the feed moves here.
+	const std::string shard_key = "feed:" + source.feed_url;
+	bool newly_acquired = false;
+	if (shards_.acquire(shard_key, newly_acquired)) {
+		std::string cursor = newly_acquired ? shards_.loadCursor(shard_key) : "";
+		if (!cursor.empty()) {
+			source.last_item_guid = std::move(cursor);
+		}
 
-	curl = curl_easy_init();
-	if (!curl) {
-		std::cerr << "Failed to initialize curl.\n";
-		return { "", "", feed_url };
+		try {
+			// The parsed document only lives for this poll, only the extracted item is kept
+			PollArena arena;
+			FeedItem latest_item = fetchLatestItem(source.feed_url, arena);
+
+			if (!latest_item.title.empty() && latest_item.title != source.last_item_guid) {
+				source.last_item_guid = latest_item.title;
+				shards_.storeCursor(shard_key, source.last_item_guid); // Before sending, a handover must not repeat it
+
+				// Archived once per feed and title, so a re-post after a restart isn't stored twice
+				if (archive_ == nullptr) {
+					AnnouncementArchive::spool(shards_.archiveInbox(), shards_.instanceId(), latest_item.feed_url, latest_item.title, latest_item.content);
+				}
+				else if (archive_->append(latest_item.feed_url, latest_item.title, latest_item.content)) {
+					bot_.log(dpp::ll_info, "Archived announcement: " + latest_item.title);
+				}
+
+				// Render once, only the role mention differs between subscribers
+				const std::string message_body = "📢 **" + latest_item.title +
+					"**\n\n---" + latest_item.content + "---\n\nSee full announcement here: " + latest_item.feed_url;
+
+				for (const auto& subscriber : source.subscribers) {
+					dpp::message msg(subscriber.discord_channel_id, message_body + "\n<@&" + subscriber.ping_role_id + ">");
+					msg.allowed_mentions.parse_roles = true;
+					bot_.message_create(msg);
+				}
+			}
+		}
+		catch (const std::exception& e) {
+			bot_.log(dpp::ll_error, "Exception while polling " + source.feed_url + ": " + std::string(e.what()));
+		}
 	}
 
-	curl_easy_setopt(curl, CURLOPT_URL, feed_url.c_str());
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &rss_content);
-	res = curl_easy_perform(curl);
+	// Reschedule relative to when the feed was due, not when the fetch finished, so polls stay in phase
+	std::lock_guard<std::mutex> lock(schedule_mutex_);
+	const uint64_t next_due = timer.due_tick + static_cast<uint64_t>(std::max(source.check_interval, 1));
+	const uint64_t now = schedule_.now();
+	schedule_.schedule(next_due > now ? next_due - now : 1, FeedTimer{ timer.source_index, std::max(next_due, now + 1) });
+}
+
+// Fetch using the shared HTTP client and libxml2
+FeedItem RSSFeedHandler::fetchLatestItem(const std::string& feed_url, PollArena& arena) {
+	XmlArenaScope xml_scope(arena);
+
+	// Feed the body to a push parser as it streams in instead of buffering the whole feed first.
+	// Chunks are parsed on the transport thread, so the arena is bound there too while it runs.
+	xmlParserCtxtPtr parser = nullptr;
+	HttpRequest request;
+	request.url = feed_url;
+	request.on_data = [&parser, &arena](const char* data, size_t size) {
+		XmlArenaScope chunk_scope(arena);
+		if (parser == nullptr) {
+			parser = xmlCreatePushParserCtxt(nullptr, nullptr, data, static_cast<int>(size), "noname.xml");
+			return parser != nullptr;
+		}
+		return xmlParseChunk(parser, data, static_cast<int>(size), 0) == 0;
+	};
 
-	if (res != CURLE_OK) {
-		std::cerr << "Failed to fetch RSS feed: " << curl_easy_strerror(res) << "\n";
-		curl_easy_cleanup(curl);
+	HttpResponse response = http_.perform(std::move(request));
+	if (!response.ok() || parser == nullptr) {
+		std::cerr << "Failed to fetch RSS feed " << feed_url << ": " << (response.ok() ? "empty response" : response.error) << "\n";
+		if (parser) {
+			xmlFreeDoc(parser->myDoc);
+			xmlFreeParserCtxt(parser);
+		}
 		return { "", "", feed_url };
 	}
 
-	// Cleanup
-	curl_easy_cleanup(curl);
-
 	// Parse w/ libxml2
-	xmlDoc* doc = xmlReadMemory(rss_content.c_str(), rss_content.size(), "noname.xml", NULL, 0);
-	if (doc == nullptr) {
+	xmlParseChunk(parser, nullptr, 0, 1);
+	xmlDoc* doc = parser->myDoc;
+	bool well_formed = parser->wellFormed;
+	xmlFreeParserCtxt(parser);
+	if (doc == nullptr || !well_formed) {
 		std::cerr << "Failed to parse RSS feed.\n";
+		xmlFreeDoc(doc);
 		return { "", "", feed_url };
 	}
 
@@ -179,7 +273,7 @@ FeedItem RSSFeedHandler::fetchLatestItem(const std::string& feed_url) {
 	xmlNode* entry = nullptr;
 
 	// First <entry> element
-	for (xmlNode* node = root_element->children; node; node = node->next) {
+	for (xmlNode* node = root_element ? root_element->children : nullptr; node; node = node->next) {
 		if (xmlStrEqual(node->name, BAD_CAST "entry")) {
 			entry = node;
 			break;
@@ -8,6 +8,19 @@
 #include <regex>
 #include <unordered_map>
 #include <algorithm>
+#include <mutex>
+#include <random>
+#include "timer_wheel.h"
+#include "worker_pool.h"
+#include "http_client.h"
+#include "poll_arena.h"
+#include "announcement_archive.h"
+#include "shard_coordinator.h"
+
+struct FeedSubscriber {
+	std::string discord_channel_id;
+	std::string ping_role_id;
+};
 
 struct FeedItem {
 	std::string title;
@@ -17,21 +30,41 @@ struct FeedItem {
 
 class RSSFeedHandler {
 public:
-	RSSFeedHandler(dpp::cluster& bot, const Config& config);
+	// archive is null on instances other than the primary, they spool items to it instead
+	RSSFeedHandler(dpp::cluster& bot, HttpClient& http, AnnouncementArchive* archive, ShardCoordinator& shards, const Config& config);
 	void start();
 
 private:
 	dpp::cluster& bot_;
+	HttpClient& http_;
+	AnnouncementArchive* archive_;
+	ShardCoordinator& shards_;
 	const Config& config_;
 
-	struct FeedState {
-		RSSFeedConfig config;
+	// One entry per unique feed_url, shared by every channel subscribed to it
+	struct FeedSource {
+		std::string feed_url;
+		int check_interval; // Shortest interval requested by any subscriber
+		std::vector<FeedSubscriber> subscribers;
 		std::string last_item_guid;
-		std::chrono::steady_clock::time_point next_check;
 	};
 
-	std::vector<FeedState> feed_states_;
+	// A due feed source and the tick it was scheduled for
+	struct FeedTimer {
+		size_t source_index;
+		uint64_t due_tick;
+	};
+
+	std::vector<FeedSource> feed_sources_;
+
+	// A source is either waiting in the wheel or being fetched by a worker, never both,
+	// so only the wheel needs locking. One tick is one second since start_time_.
+	TimerWheel<FeedTimer> schedule_;
+	std::mutex schedule_mutex_;
+	std::chrono::steady_clock::time_point start_time_;
+	WorkerPool fetch_pool_;
 
-	void checkFeeds(); 
-	FeedItem fetchLatestItem(const std::string& feed_url);
+	void checkFeeds(uint64_t tick);
+	void pollSource(const FeedTimer& timer);
+	FeedItem fetchLatestItem(const std::string& feed_url, PollArena& arena);
 };
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+struct ArchivedAnnouncement {
+	std::string feed_url;
+	std::string title;
+	std::string content;
+	int64_t archived_at = 0; // Unix seconds
+};
+
+struct SearchHit {
+	ArchivedAnnouncement announcement;
+	std::string snippet; // Part of the content around the first matching term
+	double score = 0;
+};
+
+// Every announcement ever posted, searchable by ranked (BM25) term lookup.
+//
+// On disk, under one directory:
+//  - announcements.log: append-only zlib-compressed records, never loaded into memory
+//  - documents.bin: one fixed-size entry per record (offset, dedup key, length in terms)
+//  - segment-<first>-<end>.idx: immutable inverted index segments, memory-mapped
+//
+// New items are indexed into a small in-memory table that is frozen every MEMTABLE_DOCUMENTS
+// items and written out as a segment. Segments are merged by size tier: once MERGE_FACTOR
+// adjacent ones are in the same tier they become one segment of the next tier, so each item is
+// rewritten about log(n) times and a lookup touches few files. Items not yet in a segment are
+// re-indexed from the log on startup.
+//
+// Writing and merging segments happens outside the index lock, searches only wait for the
+// swap of the finished segment into the list.
+class AnnouncementArchive {
+public:
+	static constexpr size_t MEMTABLE_DOCUMENTS = 32;
+	static constexpr size_t MERGE_FACTOR = 4;
+
+	explicit AnnouncementArchive(const std::string& directory);
+	~AnnouncementArchive();
+
+	AnnouncementArchive(const AnnouncementArchive&) = delete;
+	AnnouncementArchive& operator=(const AnnouncementArchive&) = delete;
+
+	// Archives an item unless one with the same feed and title already is. Returns whether it was added.
+	bool append(const std::string& feed_url, const std::string& title, const std::string& content);
+
+	// For instances that don't own the archive: writes the item as a file in inbox, for the owner
+	// to import. writer keeps names from different instances apart.
+	static bool spool(const std::string& inbox, const std::string& writer,
+		const std::string& feed_url, const std::string& title, const std::string& content);
+
+	// Appends every item spooled in inbox, oldest first, and removes the files. Returns how many were added.
+	size_t importSpool(const std::string& inbox);
+
+	// Best matches first, at most limit of them
+	std::vector<SearchHit> search(const std::string& query, size_t limit);
+
+	size_t size() const;
+
+	static std::vector<std::string> tokenize(std::string_view text);
+
+private:
+	struct Posting {
+		uint32_t document;
+		uint32_t frequency;
+	};
+
+	struct Document {
+		uint64_t offset;
+		uint64_t key;
+		uint32_t record_size;
+		uint32_t term_count;
+	};
+
+	class Segment;
+
+	using TermPostings = std::map<std::string, std::vector<Posting>, std::less<>>;
+
+	// A memtable that is no longer appended to, searched until its segment replaces it
+	struct FrozenMemtable {
+		uint32_t first;
+		uint32_t end;
+		TermPostings terms;
+	};
+
+	std::string directory_;
+	std::FILE* log_file_ = nullptr;
+	std::FILE* documents_file_ = nullptr;
+	int log_fd_ = -1; // Separate descriptor for concurrent reads with pread
+	uint64_t log_size_ = 0;
+
+	std::vector<Document> documents_;
+	std::unordered_set<uint64_t> keys_;
+	uint64_t total_terms_ = 0;
+
+	// In document order: segments_, then frozen_, then the memtable. Segments are shared so a
+	// merge can read them without the lock while searches keep using them.
+	std::vector<std::shared_ptr<const Segment>> segments_;
+	std::vector<std::shared_ptr<const FrozenMemtable>> frozen_;
+	TermPostings memtable_;
+	uint32_t memtable_first_ = 0; // First document not covered by a segment or frozen memtable
+
+	mutable std::shared_mutex mutex_;
+	std::mutex maintenance_mutex_; // One thread at a time writes and merges segments
+
+	bool writable() const;
+	void load();
+	void loadSegments();
+	void indexDocument(uint32_t document, const std::vector<std::string>& terms);
+	void freezeMemtable();
+	void maintainSegments();
+	bool flushFrozen();
+	bool mergeTier();
+	std::shared_ptr<const Segment> mergeSegments(const std::vector<std::shared_ptr<const Segment>>& inputs);
+	std::unique_ptr<Segment> writeSegment(uint32_t first, uint32_t end,
+		const std::vector<std::pair<std::string, std::vector<Posting>>>& terms);
+	bool readDocument(uint32_t document, ArchivedAnnouncement& announcement) const;
+
+	std::string path(const std::string& name) const;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Coin balances. Each account is an atomic so deposits and withdrawals never take a lock
+// once the account exists, the shard locks only guard account creation.
+//
+// Every change is appended to a log file as a (user, delta) record so balances survive
+// restarts. Deltas commute, so concurrent changes may be logged in any order. The log is
+// replayed and rewritten with one record per account on startup, and again whenever its
+// records reach twice the number of accounts.
+//
+// Coins withdrawn into a game's escrow are logged with the game's ID. If the bot stops before
+// the game is settled, the escrow is refunded to whoever paid in when the log is replayed.
+class Bank {
+public:
+	static constexpr int64_t STARTING_BALANCE = 500;
+
+	explicit Bank(const std::string& persist_path);
+	~Bank();
+
+	Bank(const Bank&) = delete;
+	Bank& operator=(const Bank&) = delete;
+
+	// Users without an account have STARTING_BALANCE, asking doesn't open one
+	int64_t balance(uint64_t user);
+	void deposit(uint64_t user, int64_t amount);
+
+	// Debits amount only if the balance covers it, all or nothing. A nonzero escrow ID holds
+	// the coins for that game until settle() is called with it.
+	bool withdraw(uint64_t user, int64_t amount, uint64_t escrow = 0);
+
+	// The game has paid out its escrow, so a restart must no longer refund it
+	void settle(uint64_t escrow);
+
+private:
+	static constexpr size_t SHARDS = 64;
+	// The log isn't compacted below this many records, however few accounts there are
+	static constexpr size_t MIN_COMPACT_RECORDS = 4096;
+
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<uint64_t, std::atomic<int64_t>> accounts;
+	};
+
+	std::array<Shard, SHARDS> shards_;
+
+	// (payer, amount) for every withdrawal into each unsettled escrow
+	std::unordered_map<uint64_t, std::vector<std::pair<uint64_t, int64_t>>> escrows_;
+	std::mutex escrow_mutex_;
+
+	std::string persist_path_;
+	std::FILE* persist_file_ = nullptr;
+	// Shared while changing a balance and logging it, exclusive while compacting so no change
+	// is both in the snapshot and appended after it
+	std::shared_mutex persist_mutex_;
+	std::atomic<size_t> log_records_ = 0;
+	std::atomic<size_t> compact_at_ = MIN_COMPACT_RECORDS;
+
+	std::atomic<int64_t>& account(uint64_t user);
+	void append(uint64_t user, int64_t delta, uint64_t escrow = 0);
+	void load();
+	bool compact(); // Call with persist_mutex_ held exclusively
+	void compactIfDue();
+};
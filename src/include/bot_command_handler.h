@@ -1,14 +1,25 @@
 #pragma once
 
 #include <dpp/dpp.h>
+#include "canvas_handler.h"
+#include "bank.h"
+#include "game_session.h"
+#include "cooldown_index.h"
+#include "announcement_archive.h"
 
 class bot_command_handler {
 public:
-    bot_command_handler(dpp::cluster& bot);
+    bot_command_handler(dpp::cluster& bot, CanvasHandler& canvas, AnnouncementArchive& archive);
     void handle(const dpp::slashcommand_t& event);
+    void handle_button(const dpp::button_click_t& event);
 
 private:
     dpp::cluster& bot;
+    CanvasHandler& canvas;
+    AnnouncementArchive& archive;
+    Bank bank;
+    GameSessionTable sessions;
+    CooldownIndex cooldowns;
 
     void handle_balance(const dpp::slashcommand_t& event);
     void handle_dice(const dpp::slashcommand_t& event);
@@ -20,4 +31,19 @@ private:
     void handle_richest(const dpp::slashcommand_t& event);
     void handle_work(const dpp::slashcommand_t& event);
     void handle_daily(const dpp::slashcommand_t& event);
+    void handle_assignments(const dpp::slashcommand_t& event);
+    void handle_grades(const dpp::slashcommand_t& event);
+    void handle_search(const dpp::slashcommand_t& event);
+
+    // Replies with the time left and returns false while the command is cooling down
+    bool check_cooldown(const dpp::slashcommand_t& event, CooldownCommand command, std::chrono::seconds cooldown);
+
+    // Debits a valid bet (into escrow when nonzero, see Bank) and starts the wager cooldown,
+    // replies and returns false otherwise
+    bool take_wager(const dpp::slashcommand_t& event, int64_t amount, uint64_t opponent, uint64_t escrow);
+
+    // Game sessions, see game_session.h
+    bool open_game(const dpp::slashcommand_t& event, GameKind kind, int64_t amount, uint64_t opponent);
+    bool play_move(const dpp::button_click_t& event, GameSession& session, const std::string& action, uint64_t player);
+    bool accept_challenge(const dpp::button_click_t& event, GameSession& session, const std::string& action, uint64_t player);
 };
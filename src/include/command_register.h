@@ -3,3 +3,6 @@
 #include <dpp/dpp.h>
 
 void register_global_commands(dpp::cluster& bot);
+
+// Only registers commands whose schema differs from what was last registered
+void sync_global_commands(dpp::cluster& bot);
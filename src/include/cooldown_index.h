@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class CooldownCommand : uint8_t {
+	Daily,
+	Work,
+	Wager
+};
+
+// Cooldowns keyed by (user, command). Entries are also filed into one-minute buckets by
+// expiry so expired ones are evicted by draining the buckets that have passed, never by
+// scanning the table. Cooldowns of at least PERSIST_THRESHOLD are appended to a log file
+// so they survive restarts. The log is rewritten with only the running ones on startup and
+// whenever the records it holds reach twice the live count.
+class CooldownIndex {
+public:
+	static constexpr std::chrono::seconds PERSIST_THRESHOLD{ 60 };
+	static constexpr std::chrono::seconds MAX_COOLDOWN{ 48 * 60 * 60 };
+
+	explicit CooldownIndex(const std::string& persist_path);
+	~CooldownIndex();
+
+	CooldownIndex(const CooldownIndex&) = delete;
+	CooldownIndex& operator=(const CooldownIndex&) = delete;
+
+	// Starts the cooldown and returns true if none is running, otherwise sets remaining
+	bool tryAcquire(uint64_t user, CooldownCommand command, std::chrono::seconds cooldown, std::chrono::seconds& remaining);
+
+	size_t size();
+
+private:
+	static constexpr size_t SHARDS = 64;
+	static constexpr uint32_t BUCKET_SECONDS = 60;
+	static constexpr size_t BUCKETS = MAX_COOLDOWN.count() / BUCKET_SECONDS + 2;
+	// The log isn't compacted below this many records, however few of them are live
+	static constexpr size_t MIN_COMPACT_RECORDS = 4096;
+
+	struct Key {
+		uint64_t user;
+		CooldownCommand command;
+		bool operator==(const Key& other) const noexcept { return user == other.user && command == other.command; }
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const noexcept {
+			return static_cast<size_t>((key.user ^ (static_cast<uint64_t>(key.command) << 56)) * 0x9E3779B97F4A7C15ULL);
+		}
+	};
+
+	struct Entry {
+		uint32_t expiry; // Unix seconds
+		bool persisted;
+	};
+
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<Key, Entry, KeyHash> expiries;
+		std::vector<std::vector<Key>> buckets = std::vector<std::vector<Key>>(BUCKETS);
+		uint32_t swept_bucket = 0; // Absolute bucket number everything before which is evicted
+	};
+
+	std::array<Shard, SHARDS> shards_;
+
+	std::string persist_path_;
+	std::FILE* persist_file_ = nullptr;
+	size_t log_records_ = 0;  // Records in the log file
+	size_t live_records_ = 0; // Of those, still running at the last compaction
+	std::mutex persist_mutex_;
+
+	Shard& shardFor(const Key& key);
+	void insert(Shard& shard, const Key& key, Entry entry);
+	void sweep(Shard& shard, uint32_t now);
+	void load();
+	void append(const Key& key, uint32_t expiry);
+	bool compact(); // Call with persist_mutex_ held
+
+	static uint32_t unixNow();
+};
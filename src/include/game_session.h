@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include "bank.h"
+#include "timer_wheel.h"
+
+enum class GameKind : uint8_t {
+	Dice,
+	RockPaperScissors,
+	Roulette,
+	Guess
+};
+
+// State of one game spanning several button clicks
+struct GameSession {
+	uint64_t id = 0;            // Interaction ID of the slash command that opened it
+	GameKind kind = GameKind::Dice;
+	uint64_t challenger = 0;
+	uint64_t opponent = 0;      // 0 when playing against the house
+	int64_t wager = 0;
+	int64_t escrow = 0;         // Coins taken from the players and held until the game settles
+	bool accepted = false;      // Opponent joined and their wager is in escrow
+	int challenger_move = -1;
+	int opponent_move = -1;
+	std::chrono::steady_clock::time_point expires_at;
+};
+
+// Per-thread generator, no shared state between D++ event threads
+std::mt19937_64& thread_rng();
+
+// Sessions sharded by ID so clicks on different games never contend. Expiry runs off a timer
+// wheel, an expired session has its escrow refunded to whoever paid in.
+class GameSessionTable {
+public:
+	explicit GameSessionTable(Bank& bank);
+
+	// Starts the thread that expires idle sessions
+	void start();
+
+	// The challenger's wager must already be withdrawn into session.escrow, with session.id as
+	// the bank's escrow ID so a restart refunds it
+	void open(GameSession session, std::chrono::seconds ttl);
+
+	// Runs fn on the session under its shard lock. If fn returns true the session is removed and
+	// its escrow settled in the bank, fn must have paid it out.
+	// Returns false if there is no such session (finished or expired).
+	bool update(uint64_t id, const std::function<bool(GameSession&)>& fn);
+
+	size_t size() const noexcept { return size_.load(); }
+
+private:
+	static constexpr size_t SHARDS = 64;
+
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<uint64_t, GameSession> sessions;
+	};
+
+	Bank& bank_;
+	std::array<Shard, SHARDS> shards_;
+	std::atomic<size_t> size_ = 0;
+
+	// One tick per second since start_time_
+	TimerWheel<uint64_t> expiry_;
+	std::mutex expiry_mutex_;
+	std::chrono::steady_clock::time_point start_time_;
+
+	Shard& shardFor(uint64_t id);
+	void scheduleExpiry(uint64_t id, std::chrono::steady_clock::time_point expires_at);
+	void expire(uint64_t id);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+// Allocation scope for one poll cycle. Everything parsed or diffed during the cycle is bump
+// allocated from it and released in one go when it is destroyed, so the transient data never
+// touches the shared heap the D++ threads allocate from. Not thread safe: only one thread may
+// allocate from an arena at a time.
+class PollArena {
+public:
+	explicit PollArena(size_t initial_size = 64 * 1024);
+
+	PollArena(const PollArena&) = delete;
+	PollArena& operator=(const PollArena&) = delete;
+
+	std::pmr::memory_resource* resource() noexcept { return &resource_; }
+	size_t bytesAllocated() const noexcept { return upstream_.bytes; }
+
+private:
+	// Counts what the arena takes from the heap, for logging
+	struct CountingResource : std::pmr::memory_resource {
+		size_t bytes = 0;
+
+		void* do_allocate(size_t size, size_t alignment) override;
+		void do_deallocate(void* p, size_t size, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+	};
+
+	CountingResource upstream_;
+	std::pmr::monotonic_buffer_resource resource_;
+};
+
+// Routes libxml2 allocations made on the current thread into an arena while alive. Scopes nest,
+// and a document parsed under a scope must be freed before that arena is destroyed. The first
+// scope on a thread lets libxml2 set up that thread's state on the heap before binding the arena.
+class XmlArenaScope {
+public:
+	explicit XmlArenaScope(PollArena& arena);
+	~XmlArenaScope();
+
+	XmlArenaScope(const XmlArenaScope&) = delete;
+	XmlArenaScope& operator=(const XmlArenaScope&) = delete;
+
+private:
+	std::pmr::memory_resource* previous_;
+};
+
+// Installs the libxml2 allocator hooks XmlArenaScope relies on and initializes libxml2. Outside
+// a scope the hooks fall back to malloc. Must run before libxml2 is used anywhere else, and
+// before any other thread uses it since its initialization isn't thread safe.
+void installXmlArenaAllocator();
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../config/config.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Splits polled work (feeds, courses) between bot instances sharing a state directory.
+//
+// Each instance heartbeats a member file. The live members form a consistent hash ring with
+// virtual nodes, and a key belongs to the member whose node follows the key's hash. Ring views
+// can briefly disagree while an instance joins or dies, so a key is only worked on under a lease
+// file, taken and renewed under flock: at most one instance holds it at a time. A dead
+// instance's member file and leases expire after lease_seconds and its keys move to the rest.
+//
+// Per-key cursors in the state directory let the next owner carry on where the previous one
+// stopped, e.g. without announcing the same item again.
+//
+// State that can't be split (interactions, the bank, cooldowns, the announcement archive) lives
+// on the one primary instance. Its flock on primary.lock keeps a second process from also
+// acting as primary. The others hand archive items to it through archiveInbox(). Canvas live
+// events received by an instance that doesn't poll the course are handed to the one that does
+// through liveEventsInbox().
+//
+// When sharding is disabled every key is owned locally, cursors are not stored and this
+// instance is the primary.
+class ShardCoordinator {
+public:
+	explicit ShardCoordinator(const ShardingConfig& config);
+	~ShardCoordinator();
+
+	ShardCoordinator(const ShardCoordinator&) = delete;
+	ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+
+	// Starts heartbeating and renewing held leases
+	void start();
+
+	// True if this instance should work on key now. Takes the lease if the ring assigns the key
+	// here and nobody else holds it, newly_acquired is set when it wasn't held before (load the
+	// cursor then). Releases the lease if the key has moved to another instance.
+	bool acquire(const std::string& key, bool& newly_acquired);
+
+	// Whether this instance currently holds key's lease
+	bool holds(const std::string& key);
+
+	std::string loadCursor(const std::string& key) const;
+	void storeCursor(const std::string& key, const std::string& value) const;
+
+	bool enabled() const noexcept { return config_.enabled; }
+	bool primary() const noexcept { return primary_; }
+	std::string archiveInbox() const;
+	std::string liveEventsInbox() const;
+	const std::string& instanceId() const noexcept { return instance_id_; }
+
+private:
+	using Ring = std::map<uint64_t, std::string>;
+
+	ShardingConfig config_;
+	std::string instance_id_;
+	bool primary_ = true;
+	int primary_lock_fd_ = -1; // Held for the process lifetime while primary
+
+	std::shared_ptr<const Ring> ring_;
+	std::vector<std::string> members_;
+	std::unordered_map<std::string, int64_t> held_; // Key to lease expiry
+	std::mutex mutex_;
+
+	void heartbeat();
+	void refreshMembers();
+	bool owns(const std::string& key);
+	bool writeLease(const std::string& key, bool take);
+
+	std::string memberPath(const std::string& instance) const;
+	std::string leasePath(const std::string& key) const;
+	std::string cursorPath(const std::string& key) const;
+
+	static uint64_t hash(const std::string& value);
+	static int64_t unixNow();
+};
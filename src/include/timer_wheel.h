@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Hierarchical timer wheel with 4 levels of 64 slots. Scheduling and expiry are
+// O(1) amortized regardless of how many timers are pending, entries further out
+// than the lowest level are cascaded down as the wheel turns.
+// Not thread safe, callers serialize access.
+template <typename T>
+class TimerWheel {
+public:
+	explicit TimerWheel(uint64_t start_tick = 0) : now_(start_tick) {}
+
+	// Fire value after delay_ticks (at least one tick from now)
+	void schedule(uint64_t delay_ticks, T value) {
+		if (delay_ticks == 0) {
+			delay_ticks = 1;
+		}
+		insert(Entry{ now_ + delay_ticks, std::move(value) });
+		++size_;
+	}
+
+	// Turn the wheel forward to tick, calling on_expire(T&&) for every entry that came due
+	template <typename F>
+	void advance(uint64_t tick, F&& on_expire) {
+		std::vector<Entry> expired;
+		while (now_ < tick) {
+			++now_;
+			cascade(1);
+
+			auto& slot = slots_[0][now_ & SLOT_MASK];
+			for (auto& entry : slot) {
+				expired.push_back(std::move(entry));
+			}
+			slot.clear();
+		}
+
+		// Callbacks run after the wheel is consistent so they may schedule again
+		size_ -= expired.size();
+		for (auto& entry : expired) {
+			on_expire(std::move(entry.value));
+		}
+	}
+
+	uint64_t now() const noexcept { return now_; }
+	size_t size() const noexcept { return size_; }
+
+private:
+	static constexpr unsigned LEVEL_BITS = 6;
+	static constexpr size_t SLOTS = size_t{ 1 } << LEVEL_BITS;
+	static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+	static constexpr size_t LEVELS = 4;
+
+	struct Entry {
+		uint64_t deadline;
+		T value;
+	};
+
+	std::array<std::array<std::vector<Entry>, SLOTS>, LEVELS> slots_;
+	uint64_t now_;
+	size_t size_ = 0;
+
+	void insert(Entry&& entry) {
+		const uint64_t delta = entry.deadline - now_;
+		size_t level = 0;
+		while (level + 1 < LEVELS && delta >= (uint64_t{ 1 } << (LEVEL_BITS * (level + 1)))) {
+			++level;
+		}
+
+		// Past the top level's range, park in the farthest slot and let cascading bring it back
+		uint64_t slot_tick = entry.deadline;
+		if (level == LEVELS - 1 && delta >= (uint64_t{ 1 } << (LEVEL_BITS * LEVELS))) {
+			slot_tick = now_ + (uint64_t{ 1 } << (LEVEL_BITS * LEVELS)) - 1;
+		}
+
+		slots_[level][(slot_tick >> (LEVEL_BITS * level)) & SLOT_MASK].push_back(std::move(entry));
+	}
+
+	// When the lower levels wrap, redistribute the matching slot of the level above
+	void cascade(size_t level) {
+		if (level >= LEVELS || (now_ & ((uint64_t{ 1 } << (LEVEL_BITS * level)) - 1)) != 0) {
+			return;
+		}
+		cascade(level + 1);
+
+		auto& slot = slots_[level][(now_ >> (LEVEL_BITS * level)) & SLOT_MASK];
+		std::vector<Entry> entries = std::move(slot);
+		slot.clear();
+		for (auto& entry : entries) {
+			if (entry.deadline <= now_) {
+				slots_[0][now_ & SLOT_MASK].push_back(std::move(entry));
+			} else {
+				insert(std::move(entry));
+			}
+		}
+	}
+};
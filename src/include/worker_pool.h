@@ -0,0 +1,31 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed number of threads draining a shared task queue
+class WorkerPool {
+public:
+	explicit WorkerPool(size_t thread_count);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	void submit(std::function<void()> task);
+	size_t pending() const;
+
+private:
+	std::vector<std::thread> workers_;
+	std::deque<std::function<void()>> tasks_;
+	mutable std::mutex mutex_;
+	std::condition_variable cv_;
+	bool stopping_ = false;
+
+	void run();
+};
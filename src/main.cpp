@@ -3,18 +3,33 @@
 #include <iostream>
 #include <string>
 #include <optional>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
 #include "config/config.h"
 #include "include/command_register.h"
 #include "include/bot_command_handler.h"
 #include "handlers/rss_feed_handler.h"
 #include "handlers/canvas_handler.h"
+#include "handlers/http_client.h"
+#include "include/announcement_archive.h"
+#include "include/shard_coordinator.h"
 
 std::optional<std::string> parse_args(int argc, char* argv[]);
 void display_help();
+uint32_t parse_intents(const std::vector<std::string>& names);
+dpp::cache_policy_t parse_cache_policy(const DiscordConfig& config);
+size_t resident_memory_bytes();
 
 
 
 int main(int argc, char* argv[]) {
+    const auto started = std::chrono::steady_clock::now();
+
     // Parse CLI args
     auto operation = parse_args(argc, argv);
     if (!operation) {
@@ -39,32 +54,87 @@ int main(int argc, char* argv[]) {
 		return 1;
 	}
 
-    // Create bot
-    dpp::cluster bot(BOT_TOKEN);
+    // Create bot. Only slash commands and message sends are used, so config.json can turn off
+    // the intents and caches that would otherwise hold every guild, channel, role and member.
+    const DiscordConfig& discord = Config::getInstance().getDiscordConfig();
+    dpp::cluster bot(BOT_TOKEN,
+        discord.intents ? parse_intents(*discord.intents) : dpp::i_default_intents,
+        discord.shard_count, discord.cluster_id, std::max(discord.max_clusters, 1),
+        true, parse_cache_policy(discord));
     bot.on_log(dpp::utility::cout_logger());
 
-    // Setup slash command handler
-    if (*operation == "register-on-load") {
-        register_global_commands(bot);
+	// Splits feeds and courses with other instances when sharding is enabled. Interactions and
+	// their state (bank, cooldowns, games, the archive) belong to the primary instance alone.
+	ShardCoordinator shards(Config::getInstance().getShardingConfig());
+	shards.start();
+	const bool primary = shards.primary();
+	if (shards.enabled() && primary && discord.max_clusters > 1) {
+		std::cerr << "The primary instance only receives interactions from its own gateway cluster, "
+			<< "run it with max_clusters 1 when sharding\n";
+	}
+
+    // Setup slash command handler. Commands are global, the primary registering them is enough.
+    if (discord.cluster_id == 0 && primary) {
+        if (*operation == "register-on-load") {
+            register_global_commands(bot);
+        } else if (*operation == "sync-commands") {
+            sync_global_commands(bot);
+        }
     }
 
-    bot_command_handler handler(bot);
+	// Shared HTTP transport for every Canvas and RSS request
+	HttpClient httpClient(bot, Config::getInstance().getTransportConfig());
 
-    bot.on_slashcommand([&handler](const dpp::slashcommand_t& event) {
-        handler.handle(event);
-    });
+	// Every posted announcement, searchable with /search. Other instances spool theirs to the primary.
+	std::unique_ptr<AnnouncementArchive> archive;
+	if (primary) {
+		archive = std::make_unique<AnnouncementArchive>("config/archive");
+	}
 
     // Set up RSS feed handler
-	RSSFeedHandler rssHandler(bot, Config::getInstance());
+	RSSFeedHandler rssHandler(bot, httpClient, archive.get(), shards, Config::getInstance());
 	rssHandler.start();
 
 	// Set up Canvas handler
-	CanvasHandler canvasHandler(bot, Config::getInstance().getCanvasConfig(), CANVAS_TOKEN);
+	CanvasHandler canvasHandler(bot, httpClient, shards, Config::getInstance().getCanvasConfig(), CANVAS_TOKEN);
+	if (Config::getInstance().getCanvasConfig().live_events_port > 0) {
+		const char* LIVE_EVENTS_SECRET = std::getenv("CANVASLIVEEVENTSSECRET");
+		if (LIVE_EVENTS_SECRET == nullptr || *LIVE_EVENTS_SECRET == '\0') {
+			std::cerr << "Live events are enabled but CANVASLIVEEVENTSSECRET is not set, falling back to polling\n";
+		}
+		else {
+			try {
+				canvasHandler.startLiveEvents(LIVE_EVENTS_SECRET);
+			}
+			catch (const std::exception& e) {
+				std::cerr << "Failed to start live events listener: " << e.what() << "\n";
+			}
+		}
+	}
 	canvasHandler.start();
 
+    // Commands read Canvas state, so the handler is set up after it. Only the primary answers,
+    // every other instance receiving the same interaction leaves it alone.
+    std::unique_ptr<bot_command_handler> handler;
+    if (primary) {
+        handler = std::make_unique<bot_command_handler>(bot, canvasHandler, *archive);
+
+        bot.on_slashcommand([&handler](const dpp::slashcommand_t& event) {
+            handler->handle(event);
+        });
+
+        bot.on_button_click([&handler](const dpp::button_click_t& event) {
+            handler->handle_button(event);
+        });
+    } else {
+        std::cout << "Not the primary instance, slash commands are answered by the primary\n";
+    }
+
     // Ready bot
-    bot.on_ready([&bot](const dpp::ready_t& event) {
-        std::cout << "Bot is ready!\n";
+    bot.on_ready([started](const dpp::ready_t&) {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        std::cout << "Bot is ready! " << elapsed.count() << " ms after startup, "
+            << resident_memory_bytes() / (1024 * 1024) << " MiB resident\n";
     });
 
     // Start bot
@@ -78,6 +148,7 @@ Usage: bot [options]
 Options:
   --help, -h              Show this help message and exit
   --register-on-load      Register global commands when the bot starts
+  --sync-commands         Register global commands only if their schema changed
 )";
 }
 
@@ -96,6 +167,8 @@ std::optional<std::string> parse_args(int argc, char* argv[]) {
             return std::nullopt;
         } else if (arg == "--register-on-load") {
             return "register-on-load";
+        } else if (arg == "--sync-commands") {
+            return "sync-commands";
         } else {
             std::cerr << "Unknown argument: " << arg << "\n";
             return std::nullopt;
@@ -104,3 +177,70 @@ std::optional<std::string> parse_args(int argc, char* argv[]) {
 
     return std::nullopt;
 }
+
+uint32_t parse_intents(const std::vector<std::string>& names) {
+    static const std::unordered_map<std::string, uint32_t> intents = {
+        {"guilds", dpp::i_guilds},
+        {"guild_members", dpp::i_guild_members},
+        {"guild_bans", dpp::i_guild_bans},
+        {"guild_emojis", dpp::i_guild_emojis},
+        {"guild_integrations", dpp::i_guild_integrations},
+        {"guild_webhooks", dpp::i_guild_webhooks},
+        {"guild_invites", dpp::i_guild_invites},
+        {"guild_voice_states", dpp::i_guild_voice_states},
+        {"guild_presences", dpp::i_guild_presences},
+        {"guild_messages", dpp::i_guild_messages},
+        {"guild_message_reactions", dpp::i_guild_message_reactions},
+        {"guild_message_typing", dpp::i_guild_message_typing},
+        {"direct_messages", dpp::i_direct_messages},
+        {"direct_message_reactions", dpp::i_direct_message_reactions},
+        {"direct_message_typing", dpp::i_direct_message_typing},
+        {"message_content", dpp::i_message_content},
+        {"guild_scheduled_events", dpp::i_guild_scheduled_events},
+        {"auto_moderation_configuration", dpp::i_auto_moderation_configuration},
+        {"auto_moderation_execution", dpp::i_auto_moderation_execution},
+    };
+
+    uint32_t result = 0;
+    for (const auto& name : names) {
+        auto it = intents.find(name);
+        if (it == intents.end()) {
+            std::cerr << "Ignoring unknown intent in config: " << name << "\n";
+            continue;
+        }
+        result |= it->second;
+    }
+    return result;
+}
+
+dpp::cache_policy_t parse_cache_policy(const DiscordConfig& config) {
+    auto setting = [](const std::string& value) {
+        if (value == "none") {
+            return dpp::cp_none;
+        } else if (value == "lazy") {
+            return dpp::cp_lazy;
+        } else if (value != "aggressive") {
+            std::cerr << "Unknown cache policy in config: " << value << ", using aggressive\n";
+        }
+        return dpp::cp_aggressive;
+    };
+
+    dpp::cache_policy_t policy;
+    policy.user_policy = setting(config.user_cache);
+    policy.emoji_policy = setting(config.emoji_cache);
+    policy.role_policy = setting(config.role_cache);
+    policy.channel_policy = setting(config.channel_cache);
+    policy.guild_policy = setting(config.guild_cache);
+    return policy;
+}
+
+// Resident set size from /proc/self/statm, 0 where that isn't available
+size_t resident_memory_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
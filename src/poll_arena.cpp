@@ -0,0 +1,145 @@
+#include "include/poll_arena.h"
+#include <libxml/parser.h>
+#include <libxml/xmlmemory.h>
+#include <libxml/xmlerror.h>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+PollArena::PollArena(size_t initial_size)
+	: resource_(initial_size, &upstream_) {
+}
+
+void* PollArena::CountingResource::do_allocate(size_t size, size_t alignment) {
+	void* p = std::pmr::new_delete_resource()->allocate(size, alignment);
+	bytes += size;
+	return p;
+}
+
+void PollArena::CountingResource::do_deallocate(void* p, size_t size, size_t alignment) {
+	std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+}
+
+bool PollArena::CountingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	return this == &other;
+}
+
+// libxml2 frees and reallocs without telling us the size or origin, so every block carries a
+// header. Arena blocks are released with their arena, freeing one is a no-op.
+namespace {
+	struct alignas(std::max_align_t) XmlBlockHeader {
+		size_t size;
+		bool from_arena;
+	};
+
+	thread_local std::pmr::memory_resource* current_xml_arena = nullptr;
+	thread_local bool xml_thread_warmed_up = false;
+
+	XmlBlockHeader* headerOf(void* p) {
+		return static_cast<XmlBlockHeader*>(p) - 1;
+	}
+
+	void* xmlArenaMalloc(size_t size) {
+		const size_t total = sizeof(XmlBlockHeader) + size;
+		void* block = nullptr;
+		if (current_xml_arena) {
+			try {
+				block = current_xml_arena->allocate(total, alignof(XmlBlockHeader));
+			}
+			catch (const std::bad_alloc&) {
+				return nullptr;
+			}
+		}
+		else {
+			block = std::malloc(total);
+			if (!block) {
+				return nullptr;
+			}
+		}
+
+		XmlBlockHeader* header = static_cast<XmlBlockHeader*>(block);
+		header->size = size;
+		header->from_arena = current_xml_arena != nullptr;
+		return header + 1;
+	}
+
+	void xmlArenaFree(void* p) {
+		if (p == nullptr) {
+			return;
+		}
+		XmlBlockHeader* header = headerOf(p);
+		if (!header->from_arena) {
+			std::free(header);
+		}
+	}
+
+	void* xmlArenaRealloc(void* p, size_t size) {
+		if (p == nullptr) {
+			return xmlArenaMalloc(size);
+		}
+
+		// Heap blocks stay on the heap, they may belong to state that outlives the scope
+		XmlBlockHeader* header = headerOf(p);
+		if (!header->from_arena) {
+			void* block = std::realloc(header, sizeof(XmlBlockHeader) + size);
+			if (!block) {
+				return nullptr;
+			}
+			header = static_cast<XmlBlockHeader*>(block);
+			header->size = size;
+			return header + 1;
+		}
+
+		void* moved = xmlArenaMalloc(size);
+		if (moved) {
+			std::memcpy(moved, p, header->size < size ? header->size : size);
+			xmlArenaFree(p);
+		}
+		return moved;
+	}
+
+	char* xmlArenaStrdup(const char* s) {
+		const size_t length = std::strlen(s) + 1;
+		char* copy = static_cast<char*>(xmlArenaMalloc(length));
+		if (copy) {
+			std::memcpy(copy, s, length);
+		}
+		return copy;
+	}
+
+	// libxml2 creates per-thread state (error and parser defaults) the first time a thread uses
+	// it and keeps it until the thread exits. Parsing a tiny document outside any arena makes
+	// that happen on the heap instead of in the first scope's arena.
+	void warmUpXmlThread() {
+		xml_thread_warmed_up = true;
+		xmlParserCtxtPtr parser = xmlCreatePushParserCtxt(nullptr, nullptr, nullptr, 0, nullptr);
+		if (parser == nullptr) {
+			return;
+		}
+		xmlParseChunk(parser, "<warmup/>", 9, 1);
+		xmlFreeDoc(parser->myDoc);
+		xmlFreeParserCtxt(parser);
+		xmlResetLastError();
+	}
+}
+
+XmlArenaScope::XmlArenaScope(PollArena& arena)
+	: previous_(current_xml_arena) {
+	if (!xml_thread_warmed_up && current_xml_arena == nullptr) {
+		warmUpXmlThread();
+	}
+	current_xml_arena = arena.resource();
+}
+
+XmlArenaScope::~XmlArenaScope() {
+	// libxml2 keeps the last error per thread, don't let it point into the arena afterwards
+	xmlResetLastError();
+	current_xml_arena = previous_;
+}
+
+void installXmlArenaAllocator() {
+	xmlMemSetup(xmlArenaFree, xmlArenaMalloc, xmlArenaRealloc, xmlArenaStrdup);
+	// Global tables (encodings, the dictionary lock, input callbacks) are set up here on the heap
+	xmlInitParser();
+	warmUpXmlThread();
+}
@@ -0,0 +1,339 @@
+#include "include/shard_coordinator.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+static std::string hexKey(uint64_t value) {
+	char buffer[17];
+	std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+	return buffer;
+}
+
+// Instance IDs end up in file names
+static std::string sanitizeInstanceId(const std::string& id) {
+	std::string sanitized;
+	for (char c : id) {
+		const bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.';
+		sanitized += safe ? c : '_';
+	}
+	return sanitized;
+}
+
+static std::string defaultInstanceId() {
+	char host[256] = {};
+	if (gethostname(host, sizeof(host) - 1) != 0) {
+		std::snprintf(host, sizeof(host), "host");
+	}
+	return std::string(host) + "-" + std::to_string(getpid());
+}
+
+// Written to a temporary file first so readers never see half of it
+static bool writeFileAtomically(const std::string& path, const std::string& contents, const std::string& writer) {
+	const std::string temp_path = path + "." + writer + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		if (!file || !(file << contents)) {
+			return false;
+		}
+	}
+	return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+ShardCoordinator::ShardCoordinator(const ShardingConfig& config) : config_(config) {
+	instance_id_ = sanitizeInstanceId(config_.instance_id.empty() ? defaultInstanceId() : config_.instance_id);
+	config_.lease_seconds = std::max(config_.lease_seconds, 3);
+	config_.virtual_nodes = std::max(config_.virtual_nodes, 1);
+
+	if (!config_.enabled) {
+		return;
+	}
+
+	std::error_code error;
+	for (const char* subdirectory : { "members", "leases", "cursors", "archive-inbox", "live-events-inbox" }) {
+		std::filesystem::create_directories(std::filesystem::path(config_.state_dir) / subdirectory, error);
+	}
+
+	primary_ = false;
+	if (config_.primary) {
+		const std::string lock_path = (std::filesystem::path(config_.state_dir) / "primary.lock").string();
+		primary_lock_fd_ = ::open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (primary_lock_fd_ >= 0 && flock(primary_lock_fd_, LOCK_EX | LOCK_NB) == 0) {
+			primary_ = true;
+		}
+		else {
+			std::cerr << "Another instance is already the primary in " << config_.state_dir << ", running as a secondary\n";
+			if (primary_lock_fd_ >= 0) {
+				::close(primary_lock_fd_);
+				primary_lock_fd_ = -1;
+			}
+		}
+	}
+}
+
+ShardCoordinator::~ShardCoordinator() {
+	if (primary_lock_fd_ >= 0) {
+		::close(primary_lock_fd_);
+	}
+}
+
+void ShardCoordinator::start() {
+	if (!config_.enabled) {
+		return;
+	}
+
+	// Join before the first acquire, so the ring already contains the other instances
+	heartbeat();
+	std::cout << "Sharding enabled as " << instance_id_ << (primary_ ? " (primary)" : "") << " in " << config_.state_dir << "\n";
+
+	std::thread([this]() {
+		while (true) {
+			std::this_thread::sleep_for(std::chrono::seconds(config_.lease_seconds / 3));
+			heartbeat();
+		}
+		}).detach();
+}
+
+bool ShardCoordinator::acquire(const std::string& key, bool& newly_acquired) {
+	newly_acquired = false;
+	if (!config_.enabled) {
+		return true;
+	}
+
+	const int64_t now = unixNow();
+	bool was_held = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = held_.find(key);
+		was_held = it != held_.end() && it->second > now;
+	}
+
+	if (!owns(key)) {
+		if (was_held) {
+			// Hand over right away instead of making the new owner wait for the lease to expire
+			writeLease(key, false);
+			std::lock_guard<std::mutex> lock(mutex_);
+			held_.erase(key);
+			std::cout << "Shard " << key << " moved to another instance\n";
+		}
+		return false;
+	}
+
+	if (!writeLease(key, true)) {
+		// Still leased by the previous owner, it lets go on its next poll or when the lease expires
+		std::lock_guard<std::mutex> lock(mutex_);
+		held_.erase(key);
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		held_[key] = now + config_.lease_seconds;
+	}
+	newly_acquired = !was_held;
+	if (newly_acquired) {
+		std::cout << "Acquired shard " << key << "\n";
+	}
+	return true;
+}
+
+bool ShardCoordinator::holds(const std::string& key) {
+	if (!config_.enabled) {
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = held_.find(key);
+	return it != held_.end() && it->second > unixNow();
+}
+
+std::string ShardCoordinator::loadCursor(const std::string& key) const {
+	if (!config_.enabled) {
+		return {};
+	}
+
+	std::ifstream file(cursorPath(key), std::ios::binary);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+void ShardCoordinator::storeCursor(const std::string& key, const std::string& value) const {
+	if (config_.enabled && !writeFileAtomically(cursorPath(key), value, instance_id_)) {
+		std::cerr << "Could not store cursor for shard " << key << "\n";
+	}
+}
+
+void ShardCoordinator::heartbeat() {
+	const int64_t now = unixNow();
+	if (!writeFileAtomically(memberPath(instance_id_), std::to_string(now + config_.lease_seconds), instance_id_)) {
+		std::cerr << "Could not write shard member file in " << config_.state_dir << "\n";
+	}
+
+	// Keep held leases alive between polls, which can be further apart than the lease
+	std::vector<std::string> keys;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& [key, expiry] : held_) {
+			keys.push_back(key);
+		}
+	}
+	for (const auto& key : keys) {
+		const bool renewed = writeLease(key, true);
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (renewed) {
+			held_[key] = now + config_.lease_seconds;
+		}
+		else {
+			held_.erase(key);
+		}
+	}
+
+	refreshMembers();
+}
+
+void ShardCoordinator::refreshMembers() {
+	namespace fs = std::filesystem;
+	const int64_t now = unixNow();
+	std::error_code error;
+
+	std::vector<std::string> members = { instance_id_ };
+	for (const auto& entry : fs::directory_iterator(fs::path(config_.state_dir) / "members", error)) {
+		const std::string name = entry.path().filename().string();
+		if (name == instance_id_ || entry.path().extension() == ".tmp") {
+			continue;
+		}
+
+		int64_t expiry = 0;
+		std::ifstream(entry.path()) >> expiry;
+		if (expiry > now) {
+			members.push_back(name);
+		}
+		else {
+			fs::remove(entry.path(), error); // Missed its heartbeats, presumed dead
+		}
+	}
+	std::sort(members.begin(), members.end());
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (ring_ && members == members_) {
+		return;
+	}
+
+	auto ring = std::make_shared<Ring>();
+	for (const auto& member : members) {
+		for (int node = 0; node < config_.virtual_nodes; ++node) {
+			ring->emplace(hash(member + "#" + std::to_string(node)), member);
+		}
+	}
+	ring_ = std::move(ring);
+	members_ = std::move(members);
+
+	std::string list;
+	for (const auto& member : members_) {
+		list += (list.empty() ? "" : ", ") + member;
+	}
+	std::cout << "Shard members changed (" << members_.size() << "): " << list << "\n";
+}
+
+bool ShardCoordinator::owns(const std::string& key) {
+	std::shared_ptr<const Ring> ring;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		ring = ring_;
+	}
+	if (!ring || ring->empty()) {
+		return true;
+	}
+
+	auto it = ring->lower_bound(hash(key));
+	if (it == ring->end()) {
+		it = ring->begin();
+	}
+	return it->second == instance_id_;
+}
+
+// Lease files hold "<instance> <expiry>". Taking succeeds if the lease is free, expired or
+// already ours, and extends it. Releasing clears it if it is ours.
+bool ShardCoordinator::writeLease(const std::string& key, bool take) {
+	const int fd = ::open(leasePath(key).c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	if (flock(fd, LOCK_EX) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	char buffer[512] = {};
+	const ssize_t length = pread(fd, buffer, sizeof(buffer) - 1, 0);
+	std::istringstream current(std::string(buffer, length > 0 ? static_cast<size_t>(length) : 0));
+	std::string owner;
+	int64_t expiry = 0;
+	current >> owner >> expiry;
+
+	const int64_t now = unixNow();
+	bool result = true;
+	if (take) {
+		if (owner.empty() || owner == instance_id_ || expiry <= now) {
+			const std::string lease = instance_id_ + " " + std::to_string(now + config_.lease_seconds);
+			result = ftruncate(fd, 0) == 0 && pwrite(fd, lease.data(), lease.size(), 0) == static_cast<ssize_t>(lease.size());
+		}
+		else {
+			result = false;
+		}
+	}
+	else if (owner == instance_id_) {
+		result = ftruncate(fd, 0) == 0;
+	}
+
+	flock(fd, LOCK_UN);
+	::close(fd);
+	return result;
+}
+
+std::string ShardCoordinator::archiveInbox() const {
+	return (std::filesystem::path(config_.state_dir) / "archive-inbox").string();
+}
+
+std::string ShardCoordinator::liveEventsInbox() const {
+	return (std::filesystem::path(config_.state_dir) / "live-events-inbox").string();
+}
+
+std::string ShardCoordinator::memberPath(const std::string& instance) const {
+	return (std::filesystem::path(config_.state_dir) / "members" / instance).string();
+}
+
+std::string ShardCoordinator::leasePath(const std::string& key) const {
+	return (std::filesystem::path(config_.state_dir) / "leases" / hexKey(hash(key))).string();
+}
+
+std::string ShardCoordinator::cursorPath(const std::string& key) const {
+	return (std::filesystem::path(config_.state_dir) / "cursors" / hexKey(hash(key))).string();
+}
+
+// FNV-1a with a final avalanche, so similar keys and node names spread evenly around the ring
+uint64_t ShardCoordinator::hash(const std::string& value) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (unsigned char c : value) {
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+int64_t ShardCoordinator::unixNow() {
+	return std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,51 @@
+#include "include/worker_pool.h"
+
+WorkerPool::WorkerPool(size_t thread_count) {
+	if (thread_count == 0) {
+		thread_count = 1;
+	}
+	workers_.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; ++i) {
+		workers_.emplace_back([this]() { run(); });
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	cv_.notify_all();
+	for (auto& worker : workers_) {
+		worker.join();
+	}
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		tasks_.push_back(std::move(task));
+	}
+	cv_.notify_one();
+}
+
+size_t WorkerPool::pending() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return tasks_.size();
+}
+
+void WorkerPool::run() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+			if (stopping_ && tasks_.empty()) {
+				return;
+			}
+			task = std::move(tasks_.front());
+			tasks_.pop_front();
+		}
+		task();
+	}
+}